@@ -0,0 +1,172 @@
+#ifndef ___CLASS_ASYNC
+#define ___CLASS_ASYNC
+
+#include "newbigfloat.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class task_scheduler {
+	// Work-stealing thread pool: every worker has its own deque, takes new work from the back of it and steals from the front of the others.
+	// A thread waiting for a task runs other pending tasks meanwhile, so tasks can wait for their own subtasks without
+	// blocking a worker, and nested parallelism never uses more threads than the pool has.
+private:
+	struct worker_queue {
+		std::mutex m;
+		std::deque<std::function<void()>> q;
+	};
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<int> pending;
+	std::atomic<bool> stopping;
+	std::atomic<unsigned> next_queue;
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_cv;
+	static int& worker_index() {
+		thread_local int index = -1;
+		return index;
+	}
+	bool pop(int i, std::function<void()>& f, bool back) {
+		std::lock_guard<std::mutex> lock(queues[i]->m);
+		if (queues[i]->q.empty()) return false;
+		if (back) f = std::move(queues[i]->q.back()), queues[i]->q.pop_back();
+		else f = std::move(queues[i]->q.front()), queues[i]->q.pop_front();
+		--pending;
+		return true;
+	}
+	void worker_loop(int i) {
+		worker_index() = i;
+		while (!stopping) {
+			if (run_one()) continue;
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			sleep_cv.wait(lock, [this]() { return stopping || pending > 0; });
+		}
+	}
+public:
+	task_scheduler(int threads) : queues(threads), pending(0), stopping(false), next_queue(0) {
+		for (int i = 0; i < threads; ++i) queues[i].reset(new worker_queue());
+		for (int i = 0; i < threads; ++i) workers.emplace_back([this, i]() { worker_loop(i); });
+	}
+	~task_scheduler() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stopping = true;
+		}
+		sleep_cv.notify_all();
+		for (std::thread& w : workers) w.join();
+	}
+	task_scheduler(const task_scheduler&) = delete;
+	task_scheduler& operator=(const task_scheduler&) = delete;
+	int size() const { return queues.size(); }
+	void submit(std::function<void()> f) {
+		// Workers push to their own deque, other threads spread their tasks over all deques
+		int i = worker_index();
+		if (i < 0) i = next_queue++ % queues.size();
+		{
+			std::lock_guard<std::mutex> lock(queues[i]->m);
+			queues[i]->q.push_back(std::move(f));
+			++pending;
+		}
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		sleep_cv.notify_one();
+	}
+	bool run_one() {
+		// Runs one pending task in the calling thread, if there is any
+		std::function<void()> f;
+		int self = worker_index(), n = queues.size();
+		bool found = (self >= 0 && pop(self, f, true));
+		for (int k = 0; k < n && !found; ++k) {
+			int i = (std::max(self, 0) + 1 + k) % n;
+			found = pop(i, f, false);
+		}
+		if (found) f();
+		return found;
+	}
+	template<typename Predicate>
+	void wait_until(Predicate done) {
+		// Runs pending tasks until done(). When there are none, the thread sleeps until a task finishes (finished()) or new work
+		// is submitted, instead of spinning on a core while the task it waits for runs on another worker
+		while (!done()) {
+			if (run_one()) continue;
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			sleep_cv.wait(lock, [&]() { return done() || pending > 0 || stopping; });
+		}
+	}
+	void finished() {
+		// Wakes the threads in wait_until(); taking the mutex orders this after their check of done()
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		sleep_cv.notify_all();
+	}
+};
+
+inline int scheduler_threads() {
+	// The BIGINT_THREADS environment variable overrides the number of hardware threads
+	const char* env = std::getenv("BIGINT_THREADS");
+	int n = (env != nullptr ? std::atoi(env) : int(std::thread::hardware_concurrency()));
+	return std::max(n, 1);
+}
+inline task_scheduler& scheduler() {
+	// Created at first use
+	static task_scheduler instance(scheduler_threads());
+	return instance;
+}
+
+template<typename T>
+class task {
+	// Result of an asynchronous operation. get() runs other pending tasks while it waits, and sleeps when there are none.
+private:
+	struct state {
+		std::atomic<bool> ready;
+		std::unique_ptr<T> value;
+		std::exception_ptr error;
+		state() : ready(false) {};
+	};
+	std::shared_ptr<state> s;
+public:
+	task() {};
+	template<typename Function>
+	explicit task(Function f) : s(std::make_shared<state>()) {
+		std::shared_ptr<state> st = s;
+		scheduler().submit([st, f]() {
+			try { st->value.reset(new T(f())); }
+			catch (...) { st->error = std::current_exception(); }
+			st->ready = true;
+			scheduler().finished();
+		});
+	}
+	bool valid() const { return s != nullptr; }
+	bool ready() const { return s->ready; }
+	void wait() const {
+		scheduler().wait_until([this]() { return bool(s->ready); });
+	}
+	T get() const {
+		wait();
+		if (s->error) std::rethrow_exception(s->error);
+		return *s->value;
+	}
+};
+
+template<typename Function>
+auto run_async(Function f) -> task<decltype(f())> {
+	// Runs f in the pool, with the bigfloat precision of the calling thread
+	precision_context context = bigfloat_precision();
+	return task<decltype(f())>([context, f]() {
+		precision_guard guard(context.limbs, context.mode);
+		return f();
+	});
+}
+
+inline task<bigint> mul_async(const bigint& x, const bigint& y) { return run_async([x, y]() { return x * y; }); }
+inline task<bigint> div_async(const bigint& x, const bigint& y) { return run_async([x, y]() { return x / y; }); }
+inline task<bigint> sqrt_async(const bigint& x) { return run_async([x]() { return sqrt(x); }); }
+inline task<bigfloat> mul_async(const bigfloat& x, const bigfloat& y) { return run_async([x, y]() { return x * y; }); }
+inline task<bigfloat> div_async(const bigfloat& x, const bigfloat& y) { return run_async([x, y]() { return x / y; }); }
+inline task<bigfloat> sqrt_async(const bigfloat& x, int final_scale) { return run_async([x, final_scale]() { return sqrt(x, final_scale); }); }
+
+#endif
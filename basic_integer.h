@@ -1,13 +1,39 @@
 #ifndef __CLASS_BASICINTEGER
 #define __CLASS_BASICINTEGER
 
+#include <algorithm>
+#include <functional>
+#include <string>
 #include <vector>
 #include "ntt.h"
+#include "fft.h"
 
-using modulo1 = modint<469762049, 3>; ntt<modulo1> ntt_base1;
-using modulo2 = modint<167772161, 3>; ntt<modulo2> ntt_base2;
+// The engines have no state and are constant-initialized, so any number of translation units and threads can share them
+using modulo1 = modint<469762049, 3>; inline ntt<modulo1> ntt_base1;
+using modulo2 = modint<167772161, 3>; inline ntt<modulo2> ntt_base2;
 
-const modulo1 magic_inv = modulo1(modulo2::get_mod()).binpow(modulo1::get_mod() - 2);
+inline constexpr modulo1 magic_inv = modulo1(modulo2::get_mod()).binpow(modulo1::get_mod() - 2);
+
+struct multiply_plan {
+	// How basic_integer::multiply(b, plan) computes a product, chosen by plan_multiply() to fit a memory budget
+	enum class method { standard, in_place, block };
+	method how;
+	int block_limbs; // for method::block, the size of the blocks of both operands
+	uint64_t peak_bytes; // estimated peak of the memory held during the product, including both operands and the result
+	uint64_t budget_bytes;
+	bool fits() const { return budget_bytes == 0 || peak_bytes <= budget_bytes; }
+	std::string to_string() const {
+		std::string name = (how == method::standard ? "standard" : how == method::in_place ? "in_place" : "block");
+		if (how == method::block) name += " (" + std::to_string(block_limbs) + " limbs)";
+		return name + ", estimated peak " + std::to_string(peak_bytes) + " bytes" + (budget_bytes != 0 ? " of budget " + std::to_string(budget_bytes) : "") + (fits() ? "" : " (over budget)");
+	}
+};
+inline std::function<void(const multiply_plan&)>& multiply_plan_observer() {
+	// If set, called with the plan of every product made under tuning().memory_budget_mb, before the product runs
+	// (e.g. [](const multiply_plan& p) { std::cerr << p.to_string() << std::endl; }). Set it like tuning(): while no other thread computes
+	static std::function<void(const multiply_plan&)> observer;
+	return observer;
+}
 
 template<int base>
 class basic_integer {
@@ -19,10 +45,9 @@ public:
 	int size() const { return a.size(); }
 	int nth_digit(int n) const { return a[n]; }
 	basic_integer& resize() {
-		int lim = 1;
-		for (int i = 0; i < a.size(); ++i) {
-			if (a[i] != 0) lim = i + 1;
-		}
+		// Drops leading zeros, scanning down from the top: only the zeros themselves are read
+		int lim = a.size();
+		while (lim > 1 && a[lim - 1] == 0) --lim;
 		a.resize(lim);
 		return *this;
 	}
@@ -44,15 +69,80 @@ public:
 		}
 		return *this;
 	}
-	bool operator==(const basic_integer& b) const { return a == b.a; }
-	bool operator!=(const basic_integer& b) const { return a != b.a; }
-	bool operator<(const basic_integer& b) const {
-		if (a.size() != b.a.size()) return a.size() < b.a.size();
-		for (int i = a.size() - 1; i >= 0; --i) {
-			if (a[i] != b.a[i]) return a[i] < b.a[i];
+	// Carry kernels for normalized limbs. The sum of two limbs is less than 2 * base, so a carry is a comparison and a
+	// conditional subtraction, without dividing. Blocks of 64 limbs are done by carry-lookahead: every limb takes the carry
+	// generated by the limb below it, which is independent across the block and vectorizes, and the rare limbs that
+	// then reach base (a carry passed through a limb of base - 1) are fixed afterwards.
+	static int add_limbs(int* x, const int* y, int n, int carry) {
+		// x[0..n) += y[0..n) + carry, returns the carry out
+		int i = 0;
+		for (; i + 64 <= n; i += 64) {
+			int* xs = x + i;
+			const int* ys = y + i;
+			int s[64];
+			unsigned char g[65];
+			g[0] = carry;
+			for (int k = 0; k < 64; ++k) s[k] = xs[k] + ys[k], g[k + 1] = (s[k] >= base);
+			int over = 0;
+			for (int k = 0; k < 64; ++k) {
+				xs[k] = s[k] - (g[k + 1] ? base : 0) + g[k];
+				over |= (xs[k] == base);
+			}
+			carry = g[64];
+			for (int k = 0; k < 64 && over; ++k) {
+				if (xs[k] != base) continue;
+				xs[k] = 0;
+				if (k + 1 < 64) ++xs[k + 1];
+				else carry = 1;
+			}
 		}
-		return false;
+		for (; i < n; ++i) {
+			int v = x[i] + y[i] + carry;
+			carry = (v >= base);
+			x[i] = v - (carry ? base : 0);
+		}
+		return carry;
 	}
+	static int sub_limbs(int* x, const int* y, int n, int borrow) {
+		// x[0..n) -= y[0..n) + borrow, returns the borrow out
+		int i = 0;
+		for (; i + 64 <= n; i += 64) {
+			int* xs = x + i;
+			const int* ys = y + i;
+			int s[64];
+			unsigned char g[65];
+			g[0] = borrow;
+			for (int k = 0; k < 64; ++k) s[k] = xs[k] - ys[k], g[k + 1] = (s[k] < 0);
+			int under = 0;
+			for (int k = 0; k < 64; ++k) {
+				xs[k] = s[k] + (g[k + 1] ? base : 0) - g[k];
+				under |= (xs[k] < 0);
+			}
+			borrow = g[64];
+			for (int k = 0; k < 64 && under; ++k) {
+				if (xs[k] >= 0) continue;
+				xs[k] = base - 1;
+				if (k + 1 < 64) --xs[k + 1];
+				else borrow = 1;
+			}
+		}
+		for (; i < n; ++i) {
+			int v = x[i] - y[i] - borrow;
+			borrow = (v < 0);
+			x[i] = v + (borrow ? base : 0);
+		}
+		return borrow;
+	}
+	int compare(const basic_integer& b) const {
+		// -1, 0 or 1 as *this is less than, equal to or greater than b
+		if (a.size() != b.a.size()) return a.size() < b.a.size() ? -1 : 1;
+		auto it = std::mismatch(a.rbegin(), a.rend(), b.a.rbegin());
+		if (it.first == a.rend()) return 0;
+		return *it.first < *it.second ? -1 : 1;
+	}
+	bool operator==(const basic_integer& b) const { return a == b.a; }
+	bool operator!=(const basic_integer& b) const { return a != b.a; }
+	bool operator<(const basic_integer& b) const { return compare(b) < 0; }
 	bool operator>(const basic_integer& b) const { return b < (*this); }
 	bool operator<=(const basic_integer& b) const { return !((*this) > b); }
 	bool operator>=(const basic_integer& b) const { return !((*this) < b); }
@@ -71,18 +161,28 @@ public:
 	}
 	basic_integer& operator+=(const basic_integer& b) {
 		if (a.size() < b.a.size()) a.resize(b.a.size(), 0);
-		for (int i = 0; i < b.a.size(); ++i) a[i] += b.a[i];
-		return (*this).shift();
+		int carry = add_limbs(a.data(), b.a.data(), b.a.size(), 0);
+		for (int i = b.a.size(); i < a.size() && carry; ++i) {
+			carry = (a[i] == base - 1);
+			a[i] = (carry ? 0 : a[i] + 1);
+		}
+		if (carry) a.push_back(1);
+		return *this;
 	}
 	basic_integer& operator-=(const basic_integer& b) {
-		for (int i = 0; i < b.a.size(); ++i) a[i] -= b.a[i];
-		return (*this).shift().resize();
+		// Requires *this >= b. The borrow stops at the first nonzero limb above b, and only the top can become zero
+		int borrow = sub_limbs(a.data(), b.a.data(), b.a.size(), 0);
+		for (int i = b.a.size(); i < a.size() && borrow; ++i) {
+			borrow = (a[i] == 0);
+			a[i] = (borrow ? base - 1 : a[i] - 1);
+		}
+		return (*this).resize();
 	}
-	basic_integer& operator*=(const basic_integer& b) {
-		std::vector<modulo1> mul_base1 = ntt_base1.convolve(get_modvector<modulo1>(a), get_modvector<modulo1>(b.a));
-		std::vector<modulo2> mul_base2 = ntt_base2.convolve(get_modvector<modulo2>(a), get_modvector<modulo2>(b.a));
+	basic_integer& assign_convolution(const std::vector<modulo1>& mul_base1, const std::vector<modulo2>& mul_base2) {
+		BIGINT_PHASE(instrument::phase_crt);
 		const int margin = 20;
 		a = std::vector<int>(mul_base1.size() + margin);
+		BIGINT_ALLOC(a.size() * sizeof(int));
 		for (int i = 0; i < a.size() - margin; ++i) {
 			// s * p1 + a1 = val = t * p2 + a2's solution is t = (a1 - a2) / p2 (mod p1)
 			long long val = (long long)(((mul_base1[i] - modulo1(mul_base2[i].get())) * magic_inv).get()) * modulo2::get_mod() + mul_base2[i].get();
@@ -97,13 +197,276 @@ public:
 		}
 		return (*this).resize();
 	}
+	static constexpr int fft_split() {
+		// Limbs are split into two digits of base sqrt(base) for the FFT, or the FFT is not used (0) if base is not a square
+		int r = 1;
+		while ((r + 1) * (r + 1) <= base) ++r;
+		return r * r == base ? r : 0;
+	}
+	static std::vector<int> get_fft_digits(const std::vector<int>& a, double& norm2) {
+		// Balanced digits in [-d/2, d/2), which make the round-off error of the FFT much smaller; norm2 += the sum of their squares.
+		// The top digit stays in [0, d], so the number of digits (and the transform size) doesn't grow
+		const int d = fft_split();
+		std::vector<int> v(2 * a.size());
+		int carry = 0;
+		for (int i = 0; i < a.size(); ++i) {
+			int x = a[i] + carry, lo = x % d, hi = x / d;
+			if (lo >= d / 2) lo -= d, ++hi;
+			carry = (hi >= d / 2 && i + 1 < a.size());
+			if (carry) hi -= d;
+			v[2 * i] = lo, v[2 * i + 1] = hi;
+		}
+		while (v.size() > 1 && v.back() == 0) v.pop_back();
+		for (int x : v) norm2 += double(x) * x;
+		return v;
+	}
+	basic_integer& assign_fft_product(const std::vector<long long>& c) {
+		BIGINT_PHASE(instrument::phase_crt);
+		const int d = fft_split();
+		a.assign((c.size() + 1) / 2, 0);
+		BIGINT_ALLOC(a.size() * sizeof(int));
+		long long carry = 0;
+		for (int i = 0; i < a.size(); ++i) {
+			long long v = carry + c[2 * i] + (2 * i + 1 < c.size() ? c[2 * i + 1] * d : 0);
+			long long q = v / base, r = v % base;
+			if (r < 0) r += base, --q;
+			a[i] = r, carry = q;
+		}
+		for (; carry > 0; carry /= base) a.push_back(carry % base);
+		return (*this).resize();
+	}
+	static bool use_fft(int n1, int n2) {
+		// The multiplication engine by size: the FFT in the range of the tuning table, the NTT elsewhere
+		// (for unbalanced operands, the NTT splits the larger one into blocks and is faster)
+		const tuning_table& t = tuning();
+		int lo = std::min(n1, n2), hi = std::max(n1, n2);
+		return fft_split() != 0 && lo >= t.fft_min_limbs && n1 + n2 <= t.fft_max_limbs && hi <= (long long)t.fft_max_ratio * lo;
+	}
+	bool multiply_fft(const basic_integer& b) {
+		// *this *= b by the FFT, if its error bound proves the result exact for these operands; otherwise returns false and leaves *this unchanged
+		double norm2 = 0;
+		std::vector<int> v1 = get_fft_digits(a, norm2), v2 = (&b == this ? v1 : get_fft_digits(b.a, norm2));
+		if (&b == this) norm2 *= 2;
+		int s = 1;
+		while (s < v1.size() + v2.size() - 1) s <<= 1;
+		if (!fft::is_safe(norm2, s)) return false;
+		(*this).assign_fft_product(fft_base.convolve(v1, v2));
+		return true;
+	}
+	basic_integer& operator*=(const basic_integer& b) {
+		if (tuning().memory_budget_mb != 0) {
+			multiply_plan plan = plan_multiply(a.size(), b.a.size(), uint64_t(tuning().memory_budget_mb) << 20);
+			BIGINT_PLAN(int(plan.how), plan.peak_bytes, plan.fits());
+			if (multiply_plan_observer()) multiply_plan_observer()(plan);
+			if (plan.how != multiply_plan::method::standard) return (*this).multiply(b, plan);
+		}
+		BIGINT_COUNT(instrument::op_multiply);
+		if (use_fft(a.size(), b.a.size()) && (*this).multiply_fft(b)) return *this;
+		std::vector<modulo1> mul_base1 = ntt_base1.convolve(get_modvector<modulo1>(a), get_modvector<modulo1>(b.a));
+		std::vector<modulo2> mul_base2 = ntt_base2.convolve(get_modvector<modulo2>(a), get_modvector<modulo2>(b.a));
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	static uint64_t pow2_at_least(uint64_t n) {
+		uint64_t s = 1;
+		while (s < n) s <<= 1;
+		return s;
+	}
+	static uint64_t standard_peak(uint64_t n1, uint64_t n2) {
+		// Estimated peak of operator*= (both operands and the result included), following its buffers
+		if (n1 < n2) std::swap(n1, n2);
+		if (use_fft(n1, n2)) {
+			// digits (int), two complex sequences, the coefficients (long long), and the roots of unity: built for the product above
+			// fft::cached_roots entries, before the sequences (so the two long double levels of the construction, 24 bytes per
+			// entry, don't coincide with them), and else cached, then counted once at the size of the product
+			uint64_t d = 2 * (n1 + n2), s = pow2_at_least(d);
+			return 4 * (n1 + n2) + 4 * d + 48 * s + 8 * d;
+		}
+		// Second modulus: the first result, the modvectors, the copy of the larger one, the spectrum and the buffer it was
+		// transformed in (a by-value argument, freed after the whole call), the result, and one block with its copy while it is widened
+		uint64_t s2 = pow2_at_least(n2), s1 = s2;
+		while (s1 < n1) s1 <<= 1;
+		uint64_t ntt_stage = 4 * (s1 + s2) + 4 * (n1 + n2) + 4 * s1 + 16 * s2 + 4 * (s1 + s2) + 12 * s2;
+		uint64_t crt_stage = 12 * (s1 + s2) + 4 * n2;
+		return 4 * (n1 + n2) + std::max(ntt_stage, crt_stage);
+	}
+	static uint64_t in_place_peak(uint64_t n1, uint64_t n2) {
+		// multiply_in_place(): the larger of the first modulus (operands, two buffers) and the second (b, three buffers)
+		uint64_t s = pow2_at_least(n1 + n2 - 1);
+		return std::max(4 * (n1 + n2) + 8 * s, 4 * n2 + 12 * s);
+	}
+	static uint64_t block_peak(uint64_t n1, uint64_t n2, uint64_t k) {
+		// multiply_blocks(): the operands, the result, and two blocks with their in-place product
+		k = std::min<uint64_t>(k, std::max(n1, n2));
+		return 8 * (n1 + n2) + 12 * k + in_place_peak(k, k);
+	}
+	static multiply_plan plan_multiply(int n1, int n2, uint64_t budget_bytes) {
+		// The fastest method whose estimated peak fits the budget (0: no limit): the standard product, then the in-place one,
+		// then blocks as large as fit. Blocks are at least 64 limbs and 1/32 of the larger operand, so a block plan is never much
+		// slower than the standard product. If nothing fits, the plan is the in-place product (or the standard one, when the product
+		// is too long for the in-place transforms) with fits() == false: the smallest peak short of tiny blocks, and the overrun is reported
+		multiply_plan plan = { multiply_plan::method::standard, 0, standard_peak(n1, n2), budget_bytes };
+		if (plan.fits()) return plan;
+		multiply_plan fallback = plan;
+		if (pow2_at_least(n1 + n2 - 1) <= (1 << 25)) {
+			plan.how = multiply_plan::method::in_place;
+			plan.peak_bytes = in_place_peak(std::max(n1, n2), std::min(n1, n2));
+			if (plan.fits()) return plan;
+			fallback = plan;
+		}
+		int min_block = std::max(64, std::max(n1, n2) / 32), k = 1 << 23;
+		while (k / 2 >= min_block && block_peak(n1, n2, k) > budget_bytes) k >>= 1;
+		if (block_peak(n1, n2, k) > budget_bytes) return fallback;
+		plan.how = multiply_plan::method::block;
+		plan.block_limbs = k;
+		plan.peak_bytes = block_peak(n1, n2, k);
+		return plan;
+	}
+	basic_integer& multiply_in_place(const basic_integer& b) {
+		// NTT product with the fewest buffers: one cyclic transform per operand and modulus at the size of the product, taken in
+		// place, with the pointwise products in the buffer of *this. The limbs of *this are released once both moduli have read them,
+		// and the CRT streams each coefficient into the buffer of the first modulus with a 64-bit carry, so no margin or third array is needed
+		BIGINT_COUNT(instrument::op_multiply);
+		int n = a.size() + b.a.size() - 1, s = pow2_at_least(n);
+		bool same = (&b == this);
+		std::vector<modulo1> r1(s);
+		std::vector<modulo2> r2(s);
+		BIGINT_ALLOC(s * (sizeof(modulo1) + sizeof(modulo2)));
+		for (int i = 0; i < a.size(); ++i) r1[i] = a[i], r2[i] = a[i];
+		if (!same) std::vector<int>().swap(a);
+		ntt_base1.fourier_transform(r1, false);
+		{
+			std::vector<modulo1> t(same ? 0 : s);
+			for (int i = 0; i < t.size() && i < b.a.size(); ++i) t[i] = b.a[i];
+			if (!same) ntt_base1.fourier_transform(t, false);
+			for (int i = 0; i < s; ++i) r1[i] *= (same ? r1[i] : t[i]);
+		}
+		ntt_base1.fourier_transform(r1, true);
+		ntt_base2.fourier_transform(r2, false);
+		{
+			std::vector<modulo2> t(same ? 0 : s);
+			for (int i = 0; i < t.size() && i < b.a.size(); ++i) t[i] = b.a[i];
+			if (!same) ntt_base2.fourier_transform(t, false);
+			for (int i = 0; i < s; ++i) r2[i] *= (same ? r2[i] : t[i]);
+		}
+		ntt_base2.fourier_transform(r2, true);
+		if (same) std::vector<int>().swap(a);
+		BIGINT_PHASE(instrument::phase_crt);
+		uint64_t carry = 0;
+		for (int i = 0; i < s; ++i) {
+			uint64_t val = uint64_t(((r1[i] - modulo1(r2[i].get())) * magic_inv).get()) * modulo2::get_mod() + r2[i].get();
+			carry += val;
+			r1[i] = modulo1(carry % base);
+			carry /= base;
+		}
+		std::vector<modulo2>().swap(r2);
+		a.assign(n + 1, 0);
+		for (int i = 0; i < s && i <= n; ++i) a[i] = r1[i].get();
+		for (int i = s; carry > 0; ++i) a[i] = carry % base, carry /= base;
+		return (*this).resize();
+	}
+	basic_integer& multiply_blocks(const basic_integer& b, int k) {
+		// Schoolbook over blocks of k limbs of both operands, every block product in place: beyond the operands and
+		// the result, the memory is proportional to k
+		std::vector<int> out(a.size() + b.a.size() + 1, 0);
+		for (int i = 0; i < a.size(); i += k) {
+			basic_integer x(std::vector<int>(a.begin() + i, a.begin() + std::min<int>(i + k, a.size())));
+			if (x.resize().a == std::vector<int>({ 0 })) continue;
+			for (int j = 0; j < b.a.size(); j += k) {
+				basic_integer p(std::vector<int>(b.a.begin() + j, b.a.begin() + std::min<int>(j + k, b.a.size())));
+				if (p.resize().a == std::vector<int>({ 0 })) continue;
+				p.multiply_in_place(x);
+				int carry = add_limbs(out.data() + i + j, p.a.data(), p.a.size(), 0);
+				for (int l = i + j + p.a.size(); carry; ++l) {
+					carry = (out[l] == base - 1);
+					out[l] = (carry ? 0 : out[l] + 1);
+				}
+			}
+		}
+		a.swap(out);
+		return (*this).resize();
+	}
+	basic_integer& multiply(const basic_integer& b, const multiply_plan& plan) {
+		if (plan.how == multiply_plan::method::in_place) return (*this).multiply_in_place(b);
+		if (plan.how == multiply_plan::method::block) return (*this).multiply_blocks(b, plan.block_limbs);
+		return (*this) *= b;
+	}
+	static bool short_product_pays(int n1, int n2, int t) {
+		// Whether the top t coefficients of an n1 x n2 product are cheaper by convolve_high() than by the full product and a shift.
+		// The estimate has to be clearly below that of the full NTT product, and more so in the range of the FFT, which is faster
+		int s = 1, lg = 0;
+		while (s < n1 + n2 - 1) s <<= 1, ++lg;
+		return ntt<modulo1>::convolve_low_cost(t) < 3.0 * s * lg * (use_fft(n1, n2) ? 0.6 : 0.9);
+	}
+	static basic_integer mul_high(const basic_integer& x, const basic_integer& y, int p) {
+		// Approximates the highest p digits of x * y: with k = x.size() + y.size() - p, the result r satisfies
+		// floor(x * y / base^k) - 1 <= r <= floor(x * y / base^k). Only the coefficients from x^(k - g) upwards are computed,
+		// where the g guard digits absorb the dropped partial products (at most min(x.size(), y.size()) of them per digit).
+		BIGINT_COUNT(instrument::op_mul_high);
+		int k = x.size() + y.size() - p;
+		if (k <= 0) return x * y;
+		int g = 1;
+		for (long long c = 1; c < std::min(x.size(), y.size()); c *= base) ++g;
+		int from = std::max(k - g, 0);
+		if (!short_product_pays(x.size(), y.size(), x.size() + y.size() - 1 - from)) return (x * y) >>= k;
+		basic_integer ans;
+		ans.assign_convolution(ntt_base1.convolve_high(get_modvector<modulo1>(x.a), get_modvector<modulo1>(y.a), from),
+			ntt_base2.convolve_high(get_modvector<modulo2>(x.a), get_modvector<modulo2>(y.a), from));
+		return ans >>= (k - from);
+	}
+	struct spectrum {
+		// A transformed operand, which can be multiplied many times while paying its forward transforms only once
+		ntt<modulo1>::spectrum s1;
+		ntt<modulo2>::spectrum s2;
+	};
+	spectrum get_spectrum() const {
+		return spectrum{ ntt_base1.get_spectrum(get_modvector<modulo1>(a)), ntt_base2.get_spectrum(get_modvector<modulo2>(a)) };
+	}
+	basic_integer& multiply(const spectrum& sp) {
+		std::vector<modulo1> mul_base1 = ntt_base1.convolve_spectrum(get_modvector<modulo1>(a), sp.s1);
+		std::vector<modulo2> mul_base2 = ntt_base2.convolve_spectrum(get_modvector<modulo2>(a), sp.s2);
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	basic_integer& square() {
+		BIGINT_COUNT(instrument::op_square);
+		if (use_fft(a.size(), a.size()) && (*this).multiply_fft(*this)) return *this;
+		std::vector<modulo1> mul_base1 = ntt_base1.square(get_modvector<modulo1>(a));
+		std::vector<modulo2> mul_base2 = ntt_base2.square(get_modvector<modulo2>(a));
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	basic_integer& pow(uint64_t n) {
+		// Left-to-right binary powering multiplies by the base only, so the base is transformed once and every step costs one forward transform per squaring.
+		// For tiny exponents or huge bases there is nothing to reuse, and right-to-left (square the base, multiply into the result) is used.
+		const int spectrum_limit = 1 << 22;
+		if (n == 0) return (*this) = basic_integer({ 1 });
+		if (n < 4 || a.size() > spectrum_limit) {
+			basic_integer cur = *this;
+			(*this) = basic_integer({ 1 });
+			while (true) {
+				if (n & 1) (*this) *= cur;
+				n >>= 1;
+				if (n == 0) break;
+				cur.square();
+			}
+			return *this;
+		}
+		spectrum sp = get_spectrum();
+		int bit = 63;
+		while (!(n >> bit & 1)) --bit;
+		for (--bit; bit >= 0; --bit) {
+			(*this).square();
+			if (n >> bit & 1) (*this).multiply(sp);
+		}
+		return *this;
+	}
 	basic_integer& operator/=(const basic_integer& b) {
+		BIGINT_COUNT(instrument::op_divide);
+		if (a.size() < b.a.size()) return (*this) = basic_integer();
 		int preci = a.size() - b.a.size();
 		basic_integer t({ 1 });
 		basic_integer two = basic_integer({ 2 }) << b.a.size();
 		basic_integer pre;
-		int lim = std::min(preci, 3);
-		int blim = std::min(int(b.a.size()), 6);
+		int lim = std::min(preci, tuning().div_seed_quotient);
+		int blim = std::min(int(b.a.size()), tuning().div_seed_divisor);
 		t <<= lim;
 		while (pre != t) {
 			basic_integer rb = b >> (b.a.size() - blim);
@@ -135,13 +498,16 @@ public:
 		(*this) = ans.resize();
 		return *this;
 	}
+	basic_integer& operator%=(const basic_integer& b) {
+		return (*this) -= (*this) / b * b;
+	}
 	basic_integer& divide_by_2() {
-		for (int i = a.size() - 1; i >= 0; --i) {
-			int carry = a[i] % 2;
-			a[i] /= 2;
-			if (i != 0) a[i - 1] += carry * base;
-		}
-		if (a.size() >= 2 && a.back() == 0) a.pop_back();
+		// With an even base, limb i of the half is a[i] / 2 plus base / 2 if a[i + 1] is odd: no limb depends on another result
+		static_assert(base % 2 == 0, "divide_by_2 needs an even base");
+		int n = a.size();
+		for (int i = 0; i + 1 < n; ++i) a[i] = (a[i] >> 1) + (a[i + 1] & 1) * (base / 2);
+		a[n - 1] >>= 1;
+		if (n >= 2 && a.back() == 0) a.pop_back();
 		return *this;
 	}
 	basic_integer operator<<(int x) const { return basic_integer(*this) <<= x; }
@@ -150,6 +516,7 @@ public:
 	basic_integer operator-(const basic_integer& b) const { return basic_integer(*this) -= b; }
 	basic_integer operator*(const basic_integer& b) const { return basic_integer(*this) *= b; }
 	basic_integer operator/(const basic_integer& b) const { return basic_integer(*this) /= b; }
+	basic_integer operator%(const basic_integer& b) const { return basic_integer(*this) %= b; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+#ifndef ___CLASS_BATCH
+#define ___CLASS_BATCH
+
+#include "newbigint.h"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+class bigint_batch {
+	// Many small values of the same number of limbs, stored limb-major (structure of arrays): limb i of value j is at
+	// d[i * n + j]. Every operation walks the limbs one by one and runs over all values in the inner loop, which has
+	// no branches and no divisions by a variable, so the compiler turns it into SIMD code across the values.
+private:
+	int n, w; // number of values, limbs per value
+	std::vector<int> d;
+	const int* row(int i) const { return d.data() + size_t(i) * n; }
+	int* row(int i) { return d.data() + size_t(i) * n; }
+	void widen(int width) {
+		if (width > w) d.resize(size_t(width) * n, 0), w = width;
+	}
+	void check_count(const bigint_batch& b) const {
+		// Element-wise operations need the same number of values on both sides
+		if (b.n != n) throw std::invalid_argument("bigint_batch: operands have different counts");
+	}
+public:
+	bigint_batch() : n(0), w(1) {};
+	bigint_batch(int count, int width) : n(count), w(std::max(width, 1)), d(size_t(w) * count, 0) {};
+	bigint_batch(const std::vector<bigint>& v) : n(v.size()), w(1) {
+		for (const bigint& x : v) w = std::max(w, x.size());
+		d.assign(size_t(w) * n, 0);
+		for (int j = 0; j < n; ++j) set(j, v[j]);
+	}
+	int count() const { return n; }
+	int width() const { return w; }
+	void set(int j, const bigint& x) {
+		widen(x.size());
+		for (int i = 0; i < w; ++i) row(i)[j] = (i < x.size() ? x.nth_digit(i) : 0);
+	}
+	bigint get(int j) const {
+		std::vector<int> a(w);
+		for (int i = 0; i < w; ++i) a[i] = row(i)[j];
+		return bigint(basic_integer<digit_base>(a).resize());
+	}
+	std::vector<bigint> to_vector() const {
+		std::vector<bigint> v(n);
+		for (int j = 0; j < n; ++j) v[j] = get(j);
+		return v;
+	}
+	bigint_batch& trim() {
+		// Drops the highest limbs while they are zero in every value
+		while (w > 1) {
+			const int* r = row(w - 1);
+			int any = 0;
+			for (int j = 0; j < n; ++j) any |= r[j];
+			if (any != 0) break;
+			--w;
+		}
+		d.resize(size_t(w) * n);
+		return *this;
+	}
+	bigint_batch& operator+=(const bigint_batch& b) {
+		// Element-wise; the width grows by one limb only if some value carries out of the top
+		check_count(b);
+		widen(b.w);
+		std::vector<int> carry(n, 0), zero(n, 0);
+		int* c = carry.data();
+		for (int i = 0; i < w; ++i) {
+			int* r = row(i);
+			const int* s = (i < b.w ? b.row(i) : zero.data());
+			for (int j = 0; j < n; ++j) {
+				int x = r[j] + s[j] + c[j];
+				c[j] = (x >= digit_base);
+				r[j] = x - (c[j] ? digit_base : 0);
+			}
+		}
+		int any = 0;
+		for (int j = 0; j < n; ++j) any |= c[j];
+		if (any != 0) {
+			widen(w + 1);
+			int* r = row(w - 1);
+			for (int j = 0; j < n; ++j) r[j] = c[j];
+		}
+		return *this;
+	}
+	bigint_batch& operator-=(const bigint_batch& b) {
+		// Element-wise; every value must be at least the corresponding value of b, as for bigint
+		check_count(b);
+		std::vector<int> borrow(n, 0), zero(n, 0);
+		int* c = borrow.data();
+		for (int i = 0; i < w; ++i) {
+			int* r = row(i);
+			const int* s = (i < b.w ? b.row(i) : zero.data());
+			for (int j = 0; j < n; ++j) {
+				int x = r[j] - s[j] - c[j];
+				c[j] = (x < 0);
+				r[j] = x + (c[j] ? digit_base : 0);
+			}
+		}
+		return (*this).trim();
+	}
+	bigint_batch& operator*=(const bigint_batch& b) {
+		// Element-wise schoolbook products, accumulated without carries in 32-bit words. A word receives at most one
+		// product (< base^2) per row, so carries are propagated every "rows" rows, before a word can overflow
+		check_count(b);
+		const int rows = int((UINT32_MAX - 2 * digit_base * digit_base) / (uint32_t(digit_base - 1) * (digit_base - 1)));
+		std::vector<uint32_t> acc(size_t(w + b.w) * n, 0), carry(n);
+		uint32_t* c = carry.data();
+		auto normalize = [&]() {
+			std::fill(carry.begin(), carry.end(), 0);
+			for (int i = 0; i < w + b.w; ++i) {
+				uint32_t* r = acc.data() + size_t(i) * n;
+				for (int j = 0; j < n; ++j) {
+					uint32_t x = r[j] + c[j];
+					c[j] = x / digit_base;
+					r[j] = x - c[j] * digit_base;
+				}
+			}
+		};
+		for (int k = 0; k < b.w; ++k) {
+			const int* s = b.row(k);
+			for (int i = 0; i < w; ++i) {
+				const int* r = row(i);
+				uint32_t* t = acc.data() + size_t(i + k) * n;
+				for (int j = 0; j < n; ++j) t[j] += uint32_t(r[j]) * uint32_t(s[j]);
+			}
+			if ((k + 1) % rows == 0) normalize();
+		}
+		normalize();
+		w += b.w;
+		d.assign(acc.begin(), acc.end());
+		return (*this).trim();
+	}
+	bigint_batch operator+(const bigint_batch& b) const { return bigint_batch(*this) += b; }
+	bigint_batch operator-(const bigint_batch& b) const { return bigint_batch(*this) -= b; }
+	bigint_batch operator*(const bigint_batch& b) const { return bigint_batch(*this) *= b; }
+	std::vector<int> compare(const bigint_batch& b) const {
+		// -1, 0 or 1 per value: the sign of (*this)[j] - b[j]. Decided by the highest differing limb, scanned from the top
+		check_count(b);
+		std::vector<int> ans(n, 0), zero(n, 0);
+		int* r = ans.data();
+		for (int i = std::max(w, b.w) - 1; i >= 0; --i) {
+			const int* x = (i < w ? row(i) : zero.data());
+			const int* y = (i < b.w ? b.row(i) : zero.data());
+			for (int j = 0; j < n; ++j) {
+				r[j] = (r[j] != 0 ? r[j] : (x[j] > y[j]) - (x[j] < y[j]));
+			}
+		}
+		return ans;
+	}
+};
+
+#endif
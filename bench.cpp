@@ -0,0 +1,169 @@
+// Benchmarks for bigint / bigfloat, reported as JSON.
+// Build: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// Usage: bench [--max-digits N] [--min-time SECONDS] [--filter NAME] [--out FILE] [--baseline FILE] [--tolerance RATIO]
+// With --baseline, results are compared against an earlier --out file, and the exit code is 1 if any benchmark is slower than baseline * (1 + tolerance).
+#include "pi.h"
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+using namespace std;
+
+struct bench_result {
+	string name;
+	long long digits;
+	int reps;
+	long long calls; // calls per timed run
+	double wall_min, wall_median, wall_mean, wall_stddev; // seconds
+	double cpu_median; // seconds
+	double digits_per_second; // digits / wall_median
+};
+
+mt19937_64 rng(20161);
+bigint random_bigint(long long digits) {
+	string s(digits, '0');
+	for (char& c : s) c = '0' + rng() % 10;
+	if (digits > 0) s[0] = '1' + rng() % 9;
+	return bigint(s);
+}
+
+bench_result measure(const string& name, long long digits, double min_time, const function<void()>& f) {
+	// One untimed run, then at least 3 timed runs and at least min_time seconds in total. A timed run makes enough calls to last
+	// at least 10 ms (or min_time / 10 if less), so that fast operations aren't lost in the resolution of the timers (clock() counts
+	// in microseconds at best), and reports the time per call
+	auto run = [&](long long calls, double& dw, double& dc) {
+		chrono::steady_clock::time_point w = chrono::steady_clock::now();
+		clock_t c = clock();
+		for (long long i = 0; i < calls; ++i) f();
+		dc = double(clock() - c) / CLOCKS_PER_SEC;
+		dw = chrono::duration<double>(chrono::steady_clock::now() - w).count();
+	};
+	double dw, dc, sample_time = min(0.01, min_time / 10);
+	long long calls = 1;
+	for (run(calls, dw, dc); dw < sample_time; run(calls, dw, dc)) calls *= 2;
+	vector<double> wall, cpu;
+	double total = 0;
+	while (wall.size() < 3 || total < min_time) {
+		run(calls, dw, dc);
+		wall.push_back(dw / calls);
+		cpu.push_back(dc / calls);
+		total += dw;
+	}
+	sort(wall.begin(), wall.end());
+	sort(cpu.begin(), cpu.end());
+	double mean = 0, var = 0;
+	for (double x : wall) mean += x;
+	mean /= wall.size();
+	for (double x : wall) var += (x - mean) * (x - mean);
+	var /= wall.size();
+	bench_result r;
+	r.name = name;
+	r.digits = digits;
+	r.reps = wall.size();
+	r.calls = calls;
+	r.wall_min = wall[0];
+	r.wall_median = wall[wall.size() / 2];
+	r.wall_mean = mean;
+	r.wall_stddev = sqrt(var);
+	r.cpu_median = cpu[cpu.size() / 2];
+	r.digits_per_second = digits / max(r.wall_median, 1e-12);
+	return r;
+}
+
+string to_json(const bench_result& r) {
+	ostringstream os;
+	os.precision(9);
+	os << "{\"name\": \"" << r.name << "\", \"digits\": " << r.digits << ", \"reps\": " << r.reps << ", \"calls\": " << r.calls
+		<< ", \"wall_min\": " << r.wall_min << ", \"wall_median\": " << r.wall_median << ", \"wall_mean\": " << r.wall_mean
+		<< ", \"wall_stddev\": " << r.wall_stddev << ", \"cpu_median\": " << r.cpu_median
+		<< ", \"digits_per_second\": " << r.digits_per_second << "}";
+	return os.str();
+}
+
+map<pair<string, long long>, double> read_baseline(const string& file) {
+	// Reads the wall_median of every benchmark in a file written by --out (one benchmark per line)
+	map<pair<string, long long>, double> ans;
+	ifstream is(file);
+	string line;
+	while (getline(is, line)) {
+		size_t n = line.find("\"name\": \""), d = line.find("\"digits\": "), w = line.find("\"wall_median\": ");
+		if (n == string::npos || d == string::npos || w == string::npos) continue;
+		n += 9;
+		string name = line.substr(n, line.find('"', n) - n);
+		ans[make_pair(name, stoll(line.substr(d + 10)))] = stod(line.substr(w + 15));
+	}
+	return ans;
+}
+
+int main(int argc, char** argv) {
+	long long max_digits = 1000000;
+	double min_time = 0.2, tolerance = 0.1;
+	string filter, out, baseline;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string key = argv[i], value = argv[i + 1];
+		if (key == "--max-digits") max_digits = stoll(value);
+		else if (key == "--min-time") min_time = stod(value);
+		else if (key == "--filter") filter = value;
+		else if (key == "--out") out = value;
+		else if (key == "--baseline") baseline = value;
+		else if (key == "--tolerance") tolerance = stod(value);
+		else {
+			cerr << "unknown option " << key << endl;
+			return 2;
+		}
+	}
+
+	// name, largest size (in decimal digits) it runs at, benchmark for a given size. Products are limited to what the NTT moduli can transform
+	struct bench_case {
+		string name;
+		long long limit;
+		function<function<void()>(long long)> make;
+	};
+	vector<bench_case> cases = {
+		{ "add", 100000000, [](long long n) { bigint x = random_bigint(n), y = random_bigint(n); return function<void()>([=]() { bigint z = x + y; }); } },
+		{ "sub", 100000000, [](long long n) { bigint x = random_bigint(n + 1), y = random_bigint(n); return function<void()>([=]() { bigint z = x - y; }); } },
+		{ "mul_balanced", 10000000, [](long long n) { bigint x = random_bigint(n), y = random_bigint(n); return function<void()>([=]() { bigint z = x * y; }); } },
+		{ "mul_unbalanced", 100000000, [](long long n) { bigint x = random_bigint(n), y = random_bigint(max(n / 16, 1ll)); return function<void()>([=]() { bigint z = x * y; }); } },
+		{ "square", 10000000, [](long long n) { bigint x = random_bigint(n); return function<void()>([=]() { bigint z = x; z.square(); }); } },
+		{ "div", 10000000, [](long long n) { bigint x = random_bigint(2 * n), y = random_bigint(n); return function<void()>([=]() { bigint z = x / y; }); } },
+		{ "sqrt", 10000000, [](long long n) { bigint x = random_bigint(2 * n); return function<void()>([=]() { bigint z = sqrt(x); }); } },
+		{ "parse", 100000000, [](long long n) { string s = random_bigint(n).to_string(); return function<void()>([=]() { bigint z(s); }); } },
+		{ "print", 100000000, [](long long n) { bigint x = random_bigint(n); return function<void()>([=]() { string s = x.to_string(); }); } },
+		{ "pi", 1000000, [](long long n) { int scale = max(n / digit, 1ll); return function<void()>([=]() { bigfloat z = calculate_pi(scale); }); } },
+	};
+
+	vector<bench_result> results;
+	for (const bench_case& c : cases) {
+		if (!filter.empty() && c.name.find(filter) == string::npos) continue;
+		for (long long n = 10; n <= min(max_digits, c.limit); n *= 10) {
+			results.push_back(measure(c.name, n, min_time, c.make(n)));
+			cerr << to_json(results.back()) << endl;
+		}
+	}
+
+	ostringstream json;
+	json << "{\"benchmarks\": [\n";
+	for (int i = 0; i < results.size(); ++i) json << "  " << to_json(results[i]) << (i + 1 < results.size() ? ",\n" : "\n");
+	json << "]}\n";
+	if (out.empty()) cout << json.str();
+	else ofstream(out) << json.str();
+
+	if (baseline.empty()) return 0;
+	map<pair<string, long long>, double> base = read_baseline(baseline);
+	int regressions = 0;
+	for (const bench_result& r : results) {
+		auto it = base.find(make_pair(r.name, r.digits));
+		if (it == base.end()) continue;
+		double ratio = r.wall_median / it->second;
+		if (ratio > 1 + tolerance) {
+			cerr << "REGRESSION: " << r.name << " " << r.digits << " digits: " << it->second << "s -> " << r.wall_median << "s (" << ratio << "x)" << endl;
+			++regressions;
+		}
+	}
+	cerr << regressions << " regression(s) against " << baseline << endl;
+	return regressions == 0 ? 0 : 1;
+}
@@ -1,3 +1,248 @@
+#ifndef ___CLASS_INSTRUMENT
+#define ___CLASS_INSTRUMENT
+
+// Opt-in instrumentation of the hot paths: compile with -DBIGINT_INSTRUMENT to enable it.
+// Without it, the BIGINT_COUNT / BIGINT_TRANSFORM / BIGINT_PHASE / BIGINT_ALLOC / BIGINT_PLAN macros expand to nothing.
+//   instrument_snapshot s = instrument::snapshot(); // consistent per counter, callable from any thread
+//   std::cout << s.to_text() << s.to_json();
+//   instrument::reset();
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace instrument {
+	enum operation { op_convolve, op_fourier_transform, op_multiply, op_square, op_mul_high, op_divide, op_parse, op_print, op_count };
+	enum phase { phase_forward, phase_pointwise, phase_inverse, phase_crt, phase_count };
+	const int histogram_size = 32; // bucket i counts transforms of size 2^i
+	const int plan_methods = 3; // the methods of multiply_plan, in its order
+	inline const char* operation_name(int i) {
+		static const char* names[op_count] = { "convolve", "fourier_transform", "multiply", "square", "mul_high", "divide", "parse", "print" };
+		return names[i];
+	}
+	inline const char* phase_name(int i) {
+		static const char* names[phase_count] = { "forward", "pointwise", "inverse", "crt" };
+		return names[i];
+	}
+	inline const char* plan_name(int i) {
+		static const char* names[plan_methods] = { "standard", "in_place", "block" };
+		return names[i];
+	}
+
+	struct counters {
+		std::atomic<uint64_t> calls[op_count];
+		std::atomic<uint64_t> transform_sizes[histogram_size];
+		std::atomic<uint64_t> phase_nanoseconds[phase_count];
+		std::atomic<uint64_t> bytes_allocated;
+		std::atomic<uint64_t> plans[plan_methods]; // products planned under tuning().memory_budget_mb, by method
+		std::atomic<uint64_t> plans_over_budget;
+		std::atomic<uint64_t> max_planned_peak; // largest estimated peak of those plans, in bytes
+	};
+	inline counters& global() {
+		static counters c = {};
+		return c;
+	}
+}
+
+struct instrument_snapshot {
+	uint64_t calls[instrument::op_count];
+	uint64_t transform_sizes[instrument::histogram_size];
+	uint64_t phase_nanoseconds[instrument::phase_count];
+	uint64_t bytes_allocated;
+	uint64_t plans[instrument::plan_methods];
+	uint64_t plans_over_budget;
+	uint64_t max_planned_peak;
+	std::string to_text() const {
+		std::string s;
+		for (int i = 0; i < instrument::op_count; ++i) s += std::string(instrument::operation_name(i)) + ": " + std::to_string(calls[i]) + " calls\n";
+		for (int i = 0; i < instrument::histogram_size; ++i) {
+			if (transform_sizes[i] != 0) s += "transform size 2^" + std::to_string(i) + ": " + std::to_string(transform_sizes[i]) + "\n";
+		}
+		for (int i = 0; i < instrument::phase_count; ++i) s += std::string(instrument::phase_name(i)) + ": " + std::to_string(phase_nanoseconds[i] / 1000000.0) + " ms\n";
+		s += "allocated: " + std::to_string(bytes_allocated) + " bytes\n";
+		for (int i = 0; i < instrument::plan_methods; ++i) s += std::string("plan ") + instrument::plan_name(i) + ": " + std::to_string(plans[i]) + "\n";
+		s += "plans over budget: " + std::to_string(plans_over_budget) + "\n";
+		s += "largest planned peak: " + std::to_string(max_planned_peak) + " bytes\n";
+		return s;
+	}
+	std::string to_json() const {
+		std::string s = "{\"calls\": {";
+		for (int i = 0; i < instrument::op_count; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::operation_name(i) + "\": " + std::to_string(calls[i]);
+		s += "}, \"transform_sizes\": {";
+		bool first = true;
+		for (int i = 0; i < instrument::histogram_size; ++i) {
+			if (transform_sizes[i] == 0) continue;
+			s += std::string(first ? "" : ", ") + "\"" + std::to_string(1ull << i) + "\": " + std::to_string(transform_sizes[i]);
+			first = false;
+		}
+		s += "}, \"phase_nanoseconds\": {";
+		for (int i = 0; i < instrument::phase_count; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::phase_name(i) + "\": " + std::to_string(phase_nanoseconds[i]);
+		s += "}, \"bytes_allocated\": " + std::to_string(bytes_allocated) + ", \"plans\": {";
+		for (int i = 0; i < instrument::plan_methods; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::plan_name(i) + "\": " + std::to_string(plans[i]);
+		s += "}, \"plans_over_budget\": " + std::to_string(plans_over_budget) + ", \"max_planned_peak\": " + std::to_string(max_planned_peak) + "}";
+		return s;
+	}
+};
+
+namespace instrument {
+	inline instrument_snapshot snapshot() {
+		counters& c = global();
+		instrument_snapshot s;
+		for (int i = 0; i < op_count; ++i) s.calls[i] = c.calls[i].load(std::memory_order_relaxed);
+		for (int i = 0; i < histogram_size; ++i) s.transform_sizes[i] = c.transform_sizes[i].load(std::memory_order_relaxed);
+		for (int i = 0; i < phase_count; ++i) s.phase_nanoseconds[i] = c.phase_nanoseconds[i].load(std::memory_order_relaxed);
+		s.bytes_allocated = c.bytes_allocated.load(std::memory_order_relaxed);
+		for (int i = 0; i < plan_methods; ++i) s.plans[i] = c.plans[i].load(std::memory_order_relaxed);
+		s.plans_over_budget = c.plans_over_budget.load(std::memory_order_relaxed);
+		s.max_planned_peak = c.max_planned_peak.load(std::memory_order_relaxed);
+		return s;
+	}
+	inline void reset() {
+		counters& c = global();
+		for (int i = 0; i < op_count; ++i) c.calls[i] = 0;
+		for (int i = 0; i < histogram_size; ++i) c.transform_sizes[i] = 0;
+		for (int i = 0; i < phase_count; ++i) c.phase_nanoseconds[i] = 0;
+		c.bytes_allocated = 0;
+		for (int i = 0; i < plan_methods; ++i) c.plans[i] = 0;
+		c.plans_over_budget = 0;
+		c.max_planned_peak = 0;
+	}
+	inline void count(operation op) { global().calls[op].fetch_add(1, std::memory_order_relaxed); }
+	inline void transform(uint64_t size) {
+		int lg = 0;
+		while ((2ull << lg) <= size) ++lg;
+		global().transform_sizes[lg].fetch_add(1, std::memory_order_relaxed);
+	}
+	inline void alloc(uint64_t bytes) { global().bytes_allocated.fetch_add(bytes, std::memory_order_relaxed); }
+	inline void plan(int method, uint64_t peak_bytes, bool fits) {
+		counters& c = global();
+		c.plans[method].fetch_add(1, std::memory_order_relaxed);
+		if (!fits) c.plans_over_budget.fetch_add(1, std::memory_order_relaxed);
+		uint64_t m = c.max_planned_peak.load(std::memory_order_relaxed);
+		while (m < peak_bytes && !c.max_planned_peak.compare_exchange_weak(m, peak_bytes, std::memory_order_relaxed));
+	}
+	class phase_timer {
+	private:
+		phase p;
+		std::chrono::steady_clock::time_point start;
+	public:
+		phase_timer(phase p_) : p(p_), start(std::chrono::steady_clock::now()) {};
+		~phase_timer() {
+			uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			global().phase_nanoseconds[p].fetch_add(ns, std::memory_order_relaxed);
+		}
+	};
+}
+
+#define BIGINT_CONCAT_INNER(a, b) a##b
+#define BIGINT_CONCAT(a, b) BIGINT_CONCAT_INNER(a, b)
+#ifdef BIGINT_INSTRUMENT
+#define BIGINT_COUNT(op) instrument::count(op)
+#define BIGINT_TRANSFORM(size) instrument::transform(size)
+#define BIGINT_PHASE(p) instrument::phase_timer BIGINT_CONCAT(bigint_phase_timer_, __LINE__)(p)
+#define BIGINT_ALLOC(bytes) instrument::alloc(bytes)
+#define BIGINT_PLAN(method, peak_bytes, fits) instrument::plan(method, peak_bytes, fits)
+#else
+#define BIGINT_COUNT(op) ((void)0)
+#define BIGINT_TRANSFORM(size) ((void)0)
+#define BIGINT_PHASE(p) ((void)0)
+#define BIGINT_ALLOC(bytes) ((void)0)
+#define BIGINT_PLAN(method, peak_bytes, fits) ((void)0)
+#endif
+
+#endif
+
+#ifndef ___CLASS_TUNING
+#define ___CLASS_TUNING
+
+// Crossover points between algorithms. The built-in values are used unless a config file written by tune.cpp is found:
+// the file named by the BIGINT_TUNING_FILE environment variable, or else "bigint_tuning.cfg" in the working directory.
+// The file is read once, at the first multiplication.
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+struct tuning_table {
+	int convolve_threshold = 16; // products whose smaller operand has at most this many limbs (rounded up to a power of two) use the schoolbook method
+	int short_direct_threshold = 32; // short products of at most this many coefficients are computed directly
+	int short_mulders_threshold = 1024; // short products up to this transform size split by Mulders' method, above it by a cyclic transform
+	int fft_min_limbs = 64; // products with both operands of at least this many limbs, at most fft_max_limbs in total, and
+	int fft_max_limbs = 1 << 11; // the larger operand at most fft_max_ratio times the smaller, use the floating-point FFT
+	int fft_max_ratio = 2;
+	int div_seed_quotient = 3; // limbs of the quotient and of the divisor in the first Newton steps of division
+	int div_seed_divisor = 6;
+	int tree_parallel_limbs = 4096; // product trees don't spawn tasks for subtrees smaller than this
+	int memory_budget_mb = 0; // if not 0, products follow plan_multiply() with this budget (in MiB) instead of always using the standard method
+
+	bool set(const std::string& key, int value) {
+		// A value out of range (e.g. from a hand-edited file) is rejected, and the key falls back to its built-in value:
+		// thresholds, fft_max_ratio and the seeds are at least 1, div_seed_divisor at least 2, memory_budget_mb at least 0
+		int tuning_table::* field;
+		int minimum = 1;
+		if (key == "convolve_threshold") field = &tuning_table::convolve_threshold;
+		else if (key == "short_direct_threshold") field = &tuning_table::short_direct_threshold;
+		else if (key == "short_mulders_threshold") field = &tuning_table::short_mulders_threshold;
+		else if (key == "fft_min_limbs") field = &tuning_table::fft_min_limbs;
+		else if (key == "fft_max_limbs") field = &tuning_table::fft_max_limbs;
+		else if (key == "fft_max_ratio") field = &tuning_table::fft_max_ratio;
+		else if (key == "div_seed_quotient") field = &tuning_table::div_seed_quotient;
+		else if (key == "div_seed_divisor") field = &tuning_table::div_seed_divisor, minimum = 2;
+		else if (key == "tree_parallel_limbs") field = &tuning_table::tree_parallel_limbs;
+		else if (key == "memory_budget_mb") field = &tuning_table::memory_budget_mb, minimum = 0;
+		else return false;
+		(*this).*field = (value >= minimum ? value : tuning_table().*field);
+		return value >= minimum;
+	}
+	bool load(const std::string& file) {
+		// Lines are "key value"; unknown keys and lines starting with '#' are ignored, and invalid values are replaced as in set()
+		std::ifstream is(file);
+		if (!is) return false;
+		std::string key;
+		int value;
+		while (is >> key) {
+			if (key[0] == '#') { std::getline(is, key); continue; }
+			if (is >> value) set(key, value);
+		}
+		if (div_seed_divisor < div_seed_quotient) {
+			// The Newton iteration of division can cycle forever with a divisor seed shorter than the quotient seed
+			div_seed_quotient = tuning_table().div_seed_quotient;
+			div_seed_divisor = tuning_table().div_seed_divisor;
+		}
+		return true;
+	}
+	bool save(const std::string& file) const {
+		std::ofstream os(file);
+		os << "# bigint-library tuning table (written by tune.cpp)\n";
+		os << "convolve_threshold " << convolve_threshold << "\n";
+		os << "short_direct_threshold " << short_direct_threshold << "\n";
+		os << "short_mulders_threshold " << short_mulders_threshold << "\n";
+		os << "fft_min_limbs " << fft_min_limbs << "\n";
+		os << "fft_max_limbs " << fft_max_limbs << "\n";
+		os << "fft_max_ratio " << fft_max_ratio << "\n";
+		os << "div_seed_quotient " << div_seed_quotient << "\n";
+		os << "div_seed_divisor " << div_seed_divisor << "\n";
+		os << "tree_parallel_limbs " << tree_parallel_limbs << "\n";
+		os << "memory_budget_mb " << memory_budget_mb << "\n";
+		return bool(os);
+	}
+};
+
+inline tuning_table load_tuning() {
+	tuning_table t;
+	const char* env = std::getenv("BIGINT_TUNING_FILE");
+	t.load(env != nullptr ? env : "bigint_tuning.cfg");
+	return t;
+}
+inline tuning_table& tuning() {
+	// Not synchronized: change it only while no other thread computes (tune.cpp does, between its measurements)
+	static tuning_table table = load_tuning();
+	return table;
+}
+
+#endif
+
 #ifndef ___CLASS_MODINT
 #define ___CLASS_MODINT
 
@@ -7,7 +252,7 @@
 using singlebit = uint32_t;
 using doublebit = uint64_t;
 
-static constexpr singlebit find_inv(singlebit n, int d = 5, singlebit x = 1) {
+constexpr singlebit find_inv(singlebit n, int d = 5, singlebit x = 1) {
 	return d == 0 ? x : find_inv(n, d - 1, x * (2 - x * n));
 }
 template <singlebit mod, singlebit primroot> class modint {
@@ -18,26 +263,34 @@ private:
 	static constexpr singlebit max_value = -1;
 	static constexpr singlebit r2 = (((1ull << level) % mod) << level) % mod;
 	static constexpr singlebit inv = singlebit(-1) * find_inv(mod);
-	static singlebit reduce(doublebit x) {
+	static constexpr singlebit reduce(doublebit x) {
 		singlebit res = (x + doublebit(singlebit(x) * inv) * mod) >> level;
 		return res < mod ? res : res - mod;
 	}
 public:
-	modint() : n(0) {};
-	modint(singlebit n_) { n = reduce(doublebit(n_) * r2); };
-	modint& operator=(const singlebit x) { n = reduce(doublebit(x) * r2); return *this; }
-	bool operator==(const modint& x) const { return n == x.n; }
-	bool operator!=(const modint& x) const { return n != x.n; }
-	modint& operator+=(const modint& x) { n += x.n; n -= (n < mod ? 0 : mod); return *this; }
-	modint& operator-=(const modint& x) { n += mod - x.n; n -= (n < mod ? 0 : mod); return *this; }
-	modint& operator*=(const modint& x) { n = reduce(1ull * n * x.n); return *this; }
-	modint operator+(const modint& x) const { return modint(*this) += x; }
-	modint operator-(const modint& x) const { return modint(*this) -= x; }
-	modint operator*(const modint& x) const { return modint(*this) *= x; }
-	static singlebit get_mod() { return mod; }
-	static singlebit get_primroot() { return primroot; }
-	singlebit get() { return reduce(doublebit(n)); }
-	modint binpow(singlebit b) {
+	constexpr modint() : n(0) {};
+	constexpr modint(singlebit n_) : n(reduce(doublebit(n_) * r2)) {};
+	constexpr modint& operator=(const singlebit x) { n = reduce(doublebit(x) * r2); return *this; }
+	constexpr bool operator==(const modint& x) const { return n == x.n; }
+	constexpr bool operator!=(const modint& x) const { return n != x.n; }
+	constexpr modint& operator+=(const modint& x) { n += x.n; n -= (n < mod ? 0 : mod); return *this; }
+	constexpr modint& operator-=(const modint& x) { n += mod - x.n; n -= (n < mod ? 0 : mod); return *this; }
+	constexpr modint& operator*=(const modint& x) { n = reduce(1ull * n * x.n); return *this; }
+	constexpr modint operator+(const modint& x) const { return modint(*this) += x; }
+	constexpr modint operator-(const modint& x) const { return modint(*this) -= x; }
+	constexpr modint operator*(const modint& x) const { return modint(*this) *= x; }
+	static constexpr singlebit get_mod() { return mod; }
+	static constexpr singlebit get_primroot() { return primroot; }
+	constexpr singlebit get() const { return reduce(doublebit(n)); }
+	// Raw Montgomery residues, for kernels that keep them lazily in [0, 2 * mod) between steps (the transforms of ntt.h)
+	constexpr singlebit raw() const { return n; }
+	static constexpr modint from_raw(singlebit x) { modint r; r.n = x; return r; }
+	static constexpr singlebit mul_lazy(singlebit x, singlebit y) {
+		// Montgomery product without the final subtraction: in [0, 2 * mod) if x * y < mod * 2^32 (e.g. x < 4 * mod, y < mod)
+		doublebit z = doublebit(x) * y;
+		return (z + doublebit(singlebit(z) * inv) * mod) >> level;
+	}
+	constexpr modint binpow(singlebit b) const {
 		modint ans(1), cur(*this);
 		while (b > 0) {
 			if (b & 1) ans *= cur;
@@ -49,8 +302,9 @@ public:
 };
 
 template<typename modulo>
-std::vector<modulo> get_modvector(std::vector<int> v) {
+std::vector<modulo> get_modvector(const std::vector<int>& v) {
 	std::vector<modulo> ans(v.size());
+	BIGINT_ALLOC(ans.size() * sizeof(modulo));
 	for (int i = 0; i < v.size(); ++i) {
 		ans[i] = v[i];
 	}
@@ -63,76 +317,267 @@ std::vector<modulo> get_modvector(std::vector<int> v) {
 #define ___CLASS_NTT
 
 #include <vector>
+#include <array>
+#include <algorithm>
+
+template<typename modulo>
+constexpr int ntt_depth() {
+	// The largest d such that 2^d divides mod - 1, so that the transform size is up to 2^d
+	int depth = 0;
+	for (uint32_t div_number = modulo::get_mod() - 1; div_number % 2 == 0; div_number >>= 1) ++depth;
+	return depth;
+}
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_roots(bool inverse) {
+	// roots[i] is a primitive 2^i-th root of unity (or its inverse)
+	constexpr int depth = ntt_depth<modulo>();
+	std::array<modulo, 32> roots = {};
+	roots[depth] = modulo(modulo::get_primroot()).binpow((modulo::get_mod() - 1) >> depth);
+	if (inverse) roots[depth] = roots[depth].binpow(modulo::get_mod() - 2);
+	for (int i = depth - 1; i >= 0; --i) roots[i] = roots[i + 1] * roots[i + 1];
+	return roots;
+}
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_powinv() {
+	// powinv[i] = 1 / 2^i
+	std::array<modulo, 32> powinv = {};
+	powinv[0] = 1;
+	for (int i = 1; i < 32; ++i) powinv[i] = powinv[i - 1] * modulo((modulo::get_mod() + 1) / 2);
+	return powinv;
+}
+
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_rates(int radix_log, bool inverse) {
+	// Twiddle steps of the radix-2 (radix_log = 1) and radix-4 (radix_log = 2) passes, which visit the blocks of a level in
+	// bit-reversed order: going from block s to block s + 1, where s ends with exactly i one bits, multiplies the twiddle by rates[i]
+	std::array<modulo, 32> roots = ntt_roots<modulo>(inverse), iroots = ntt_roots<modulo>(!inverse), rates = {};
+	modulo prod(1);
+	for (int i = 0; i + radix_log + 1 <= ntt_depth<modulo>(); ++i) {
+		rates[i] = roots[i + radix_log + 1] * prod;
+		prod *= iroots[i + radix_log + 1];
+	}
+	return rates;
+}
 
 template<typename modulo>
 class ntt {
 	// Number Theoretic Transform
+	// All tables are computed at compile time and the engine has no state, so one instance can be shared by every thread
 private:
-	int depth;
-	std::vector<modulo> roots;
-	std::vector<modulo> powinv;
+	static constexpr int depth = ntt_depth<modulo>();
+	static constexpr std::array<modulo, 32> roots = ntt_roots<modulo>(false);
+	static constexpr std::array<modulo, 32> iroots = ntt_roots<modulo>(true);
+	static constexpr std::array<modulo, 32> powinv = ntt_powinv<modulo>();
+	static constexpr std::array<modulo, 32> rate2 = ntt_rates<modulo>(1, false);
+	static constexpr std::array<modulo, 32> rate3 = ntt_rates<modulo>(2, false);
+	static constexpr std::array<modulo, 32> irate3 = ntt_rates<modulo>(2, true);
+	// The passes work on the raw Montgomery residues and keep them in [0, 2 * mod) (Harvey's lazy reduction): a butterfly adds
+	// two of them and reduces the sum once, below 4 * mod, so no sum of the transforms overflows 32 bits
+	static_assert(modulo::get_mod() < (1u << 30), "lazy reduction needs 4 * mod < 2^32");
+	static_assert(sizeof(modulo) == sizeof(singlebit), "the transforms work on the raw residues of a modulo array");
+	static constexpr singlebit mod = modulo::get_mod(), mod2 = 2 * modulo::get_mod();
+	static singlebit reduce2(singlebit x) { return x - (x >= mod2 ? mod2 : 0); } // [0, 4 * mod) to [0, 2 * mod)
+	static int trailing_ones(int s) {
+		int k = 0;
+		while (s >> k & 1) ++k;
+		return k;
+	}
+	static void forward_dif(singlebit* v, int h) {
+		// Decimation in frequency on 2^h elements, two levels per pass (radix 4) and one radix-2 pass at the end if h is odd.
+		// The input is in natural order and the output in bit-reversed order, so no permutation is needed
+		int len = 0;
+		while (len < h) {
+			if (h - len == 1) {
+				int p = 1 << (h - len - 1);
+				modulo rot(1);
+				for (int s = 0; s < (1 << len); ++s) {
+					singlebit* x = v + (s << (h - len));
+					singlebit w = rot.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit l = x[i], r = modulo::mul_lazy(x[i + p], w);
+						x[i] = reduce2(l + r);
+						x[i + p] = reduce2(l + mod2 - r);
+					}
+					if (s + 1 != (1 << len)) rot *= rate2[trailing_ones(s)];
+				}
+				len += 1;
+			}
+			else {
+				int p = 1 << (h - len - 2);
+				modulo rot(1);
+				const singlebit imag = roots[2].raw();
+				for (int s = 0; s < (1 << len); ++s) {
+					singlebit* x = v + (s << (h - len));
+					modulo rot2 = rot * rot, rot3 = rot2 * rot;
+					singlebit w1 = rot.raw(), w2 = rot2.raw(), w3 = rot3.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit a0 = x[i];
+						singlebit a1 = modulo::mul_lazy(x[i + p], w1);
+						singlebit a2 = modulo::mul_lazy(x[i + 2 * p], w2);
+						singlebit a3 = modulo::mul_lazy(x[i + 3 * p], w3);
+						singlebit b0 = reduce2(a0 + a2), b1 = reduce2(a0 + mod2 - a2);
+						singlebit c0 = reduce2(a1 + a3), c1 = modulo::mul_lazy(a1 + mod2 - a3, imag);
+						x[i] = reduce2(b0 + c0);
+						x[i + p] = reduce2(b0 + mod2 - c0);
+						x[i + 2 * p] = reduce2(b1 + c1);
+						x[i + 3 * p] = reduce2(b1 + mod2 - c1);
+					}
+					if (s + 1 != (1 << len)) rot *= rate3[trailing_ones(s)];
+				}
+				len += 2;
+			}
+		}
+	}
+	static void inverse_dit(singlebit* v, int h) {
+		// Decimation in time, radix 4 from the smallest blocks up: bit-reversed order in, natural order out. If h is odd, the last
+		// pass is a radix-2 one over the whole array, a single block whose twiddle is 1
+		int len = h;
+		while (len > 0) {
+			if (len == 1) {
+				int p = 1 << (h - 1);
+				singlebit* x = v;
+				for (int i = 0; i < p; ++i) {
+					singlebit l = x[i], r = x[i + p];
+					x[i] = reduce2(l + r);
+					x[i + p] = reduce2(l + mod2 - r);
+				}
+				len -= 1;
+			}
+			else {
+				int p = 1 << (h - len);
+				modulo irot(1);
+				const singlebit iimag = iroots[2].raw();
+				for (int s = 0; s < (1 << (len - 2)); ++s) {
+					singlebit* x = v + (s << (h - len + 2));
+					modulo irot2 = irot * irot, irot3 = irot2 * irot;
+					singlebit w1 = irot.raw(), w2 = irot2.raw(), w3 = irot3.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit a0 = x[i], a1 = x[i + p], a2 = x[i + 2 * p], a3 = x[i + 3 * p];
+						singlebit b0 = reduce2(a0 + a1), b1 = reduce2(a0 + mod2 - a1);
+						singlebit c0 = reduce2(a2 + a3), c1 = modulo::mul_lazy(a2 + mod2 - a3, iimag);
+						x[i] = reduce2(b0 + c0);
+						x[i + p] = modulo::mul_lazy(b1 + c1, w1);
+						x[i + 2 * p] = modulo::mul_lazy(b0 + mod2 - c0, w2);
+						x[i + 3 * p] = modulo::mul_lazy(b1 + mod2 - c1, w3);
+					}
+					if (s + 1 != (1 << (len - 2))) irot *= irate3[trailing_ones(s)];
+				}
+				len -= 2;
+			}
+		}
+	}
 public:
-	ntt() {
-		depth = 0;
-		uint32_t div_number = modulo::get_mod() - 1;
-		while (div_number % 2 == 0) div_number >>= 1, ++depth;
-		modulo b = modulo::get_primroot();
-		for (int i = 0; i < depth; ++i) b *= b;
-		modulo baseroot = modulo::get_primroot(), bb = b;
-		while (bb != 1) bb *= b, baseroot *= modulo::get_primroot();
-		roots = std::vector<modulo>(depth + 1, 0);
-		powinv = std::vector<modulo>(depth + 1, 0);
-		powinv[1] = (modulo::get_mod() + 1) / 2;
-		for (int i = 2; i <= depth; ++i) powinv[i] = powinv[i - 1] * powinv[1];
-		roots[depth] = 1;
-		for (int i = 0; i < modulo::get_mod() - 1; i += 1 << depth) roots[depth] *= baseroot;
-		for (int i = depth - 1; i >= 1; --i) roots[i] = roots[i + 1] * roots[i + 1];
+	void transform(modulo* v, int s, bool inverse) {
+		// In place on a caller buffer of s elements (a power of two, up to 2^depth). The forward transform leaves the spectrum in
+		// bit-reversed order, which the inverse takes back, so spectra are only meant to be multiplied pointwise with spectra of the
+		// same size. The inverse includes the division by s, so transform(v, s, true) undoes transform(v, s, false)
+		BIGINT_COUNT(instrument::op_fourier_transform);
+		BIGINT_TRANSFORM(s);
+		BIGINT_PHASE(inverse ? instrument::phase_inverse : instrument::phase_forward);
+		int h = 0;
+		while ((1 << h) < s) ++h;
+		singlebit* x = reinterpret_cast<singlebit*>(v);
+		if (!inverse) {
+			forward_dif(x, h);
+			for (int i = 0; i < s; ++i) x[i] -= (x[i] >= mod ? mod : 0);
+		}
+		else {
+			inverse_dit(x, h);
+			const singlebit f = powinv[h].raw();
+			for (int i = 0; i < s; ++i) {
+				x[i] = modulo::mul_lazy(x[i], f);
+				x[i] -= (x[i] >= mod ? mod : 0);
+			}
+		}
 	}
 	void fourier_transform(std::vector<modulo> &v, bool inverse) {
-		int s = v.size();
-		for (int i = 0, j = 1; j < s - 1; ++j) {
-			for (int k = s >> 1; k >(i ^= k); k >>= 1);
-			if (i < j) std::swap(v[i], v[j]);
-		}
-		int sc = 0, sz = 1;
-		while (sz < s) sz *= 2, ++sc;
-		std::vector<modulo> pw(s + 1); pw[0] = 1;
-		for (int i = 1; i <= s; i++) pw[i] = pw[i - 1] * roots[sc];
-		int qs = s;
-		for (int b = 1; b < s; b <<= 1) {
-			qs >>= 1;
-			for (int i = 0; i < s; i += b * 2) {
-				for (int j = i; j < i + b; ++j) {
-					modulo delta = pw[(inverse ? b * 2 - j + i : j - i) * qs] * v[j + b];
-					v[j + b] = v[j] - delta;
-					v[j] += delta;
+		transform(v.data(), v.size(), inverse);
+	}
+	void convolve_batch(const modulo* v1, int n1, const modulo* v2, int n2, modulo* out, int count) {
+		// count products at once: v1 holds count polynomials of n1 coefficients one after another, v2 count of n2, and product i
+		// (n1 + n2 - 1 coefficients) is written at out + i * (n1 + n2 - 1). The two work buffers are shared by all of them
+		if (count <= 0 || n1 <= 0 || n2 <= 0) return;
+		int n = n1 + n2 - 1;
+		BIGINT_COUNT(instrument::op_convolve);
+		if (std::min(n1, n2) <= tuning().convolve_threshold) {
+			for (int c = 0; c < count; ++c) {
+				const modulo* x = v1 + size_t(c) * n1;
+				const modulo* y = v2 + size_t(c) * n2;
+				modulo* z = out + size_t(c) * n;
+				std::fill(z, z + n, modulo());
+				for (int i = 0; i < n1; ++i) {
+					for (int j = 0; j < n2; ++j) {
+						z[i + j] += x[i] * y[j];
+					}
 				}
 			}
+			return;
 		}
-		if (inverse) {
-			for (int i = 0; i < s; ++i) v[i] *= powinv[sc];
+		int s = 1;
+		while (s < n) s <<= 1;
+		std::vector<modulo> x(s), y(s);
+		BIGINT_ALLOC(2 * s * sizeof(modulo));
+		for (int c = 0; c < count; ++c) {
+			std::copy(v1 + size_t(c) * n1, v1 + size_t(c + 1) * n1, x.begin());
+			std::fill(x.begin() + n1, x.end(), modulo());
+			std::copy(v2 + size_t(c) * n2, v2 + size_t(c + 1) * n2, y.begin());
+			std::fill(y.begin() + n2, y.end(), modulo());
+			transform(x.data(), s, false);
+			transform(y.data(), s, false);
+			{
+				BIGINT_PHASE(instrument::phase_pointwise);
+				for (int i = 0; i < s; ++i) x[i] *= y[i];
+			}
+			transform(x.data(), s, true);
+			std::copy(x.begin(), x.begin() + n, out + size_t(c) * n);
 		}
 	}
-	std::vector<modulo> convolve(std::vector<modulo> v1, std::vector<modulo> v2) {
-		const int threshold = 16;
-		if (v1.size() < v2.size()) swap(v1, v2);
-		int s1 = 1; while (s1 < v1.size()) s1 <<= 1; v1.resize(s1);
-		int s2 = 1; while (s2 < v2.size()) s2 <<= 1; v2.resize(s2 * 2);
-		std::vector<modulo> ans(s1 + s2);
+	std::vector<modulo> convolve_batch(const std::vector<modulo>& v1, int n1, const std::vector<modulo>& v2, int n2) {
+		// The same on vectors: v1.size() / n1 (= v2.size() / n2) products, concatenated in the result
+		int count = (n1 > 0 ? v1.size() / n1 : 0);
+		std::vector<modulo> ans(size_t(count) * std::max(n1 + n2 - 1, 0));
+		convolve_batch(v1.data(), n1, v2.data(), n2, ans.data(), count);
+		return ans;
+	}
+	struct spectrum {
+		// Operand prepared for convolve_spectrum(): padded to a power of two s2, and transformed at size 2 * s2 unless it is small enough for the schoolbook method
+		int s2;
+		bool transformed;
+		std::vector<modulo> v;
+	};
+	spectrum get_spectrum(std::vector<modulo> v2) {
+		const int threshold = tuning().convolve_threshold;
+		int s2 = 1; while (s2 < v2.size()) s2 <<= 1;
 		if (s2 <= threshold) {
+			v2.resize(s2);
+			return spectrum{ s2, false, v2 };
+		}
+		v2.resize(s2 * 2);
+		fourier_transform(v2, false);
+		return spectrum{ s2, true, v2 };
+	}
+	std::vector<modulo> convolve_spectrum(std::vector<modulo> v1, const spectrum& sp) {
+		int s2 = sp.s2;
+		int s1 = s2; while (s1 < v1.size()) s1 <<= 1; v1.resize(s1);
+		std::vector<modulo> ans(s1 + s2);
+		BIGINT_COUNT(instrument::op_convolve);
+		BIGINT_ALLOC((s1 + s2) * sizeof(modulo));
+		if (!sp.transformed) {
 			for (int i = 0; i < s1; ++i) {
 				for (int j = 0; j < s2; ++j) {
-					ans[i + j] += v1[i] * v2[j];
+					ans[i + j] += v1[i] * sp.v[j];
 				}
 			}
 		}
 		else {
-			fourier_transform(v2, false);
 			for (int i = 0; i < s1; i += s2) {
 				std::vector<modulo> v(v1.begin() + i, v1.begin() + i + s2);
 				v.resize(s2 * 2);
 				fourier_transform(v, false);
-				for (int j = 0; j < v.size(); ++j) v[j] *= v2[j];
+				{
+					BIGINT_PHASE(instrument::phase_pointwise);
+					for (int j = 0; j < v.size(); ++j) v[j] *= sp.v[j];
+				}
 				fourier_transform(v, true);
 				for (int j = 0; j < s2 * 2; ++j) {
 					ans[i + j] += v[j];
@@ -141,19 +586,262 @@ public:
 		}
 		return ans;
 	}
+	std::vector<modulo> convolve(std::vector<modulo> v1, std::vector<modulo> v2) {
+		if (v1.size() < v2.size()) swap(v1, v2);
+		return convolve_spectrum(v1, get_spectrum(v2));
+	}
+	std::vector<modulo> square(std::vector<modulo> v) {
+		// Same as convolve(v, v), but with a single forward transform
+		const int threshold = tuning().convolve_threshold;
+		int s = 1; while (s < v.size()) s <<= 1;
+		std::vector<modulo> ans(s * 2);
+		if (s <= threshold) {
+			v.resize(s);
+			for (int i = 0; i < s; ++i) {
+				for (int j = 0; j < s; ++j) {
+					ans[i + j] += v[i] * v[j];
+				}
+			}
+			return ans;
+		}
+		v.resize(s * 2);
+		fourier_transform(v, false);
+		for (int i = 0; i < v.size(); ++i) v[i] *= v[i];
+		fourier_transform(v, true);
+		return v;
+	}
+	std::vector<modulo> cyclic_convolve(std::vector<modulo> v1, std::vector<modulo> v2, int s) {
+		// Convolution modulo x^s - 1 (s is a power of two, and both vectors must have at most s elements)
+		v1.resize(s); v2.resize(s);
+		fourier_transform(v1, false);
+		fourier_transform(v2, false);
+		for (int i = 0; i < s; ++i) v1[i] *= v2[i];
+		fourier_transform(v1, true);
+		return v1;
+	}
+	static double convolve_low_cost(int t) {
+		// Estimated work of convolve_low() with t coefficients, in butterflies. Returns the cost of a full product when splitting doesn't pay
+		if (t <= tuning().short_direct_threshold) return 0.5 * t * t;
+		int s = 1, lg = 0; while (s < t) s <<= 1, ++lg;
+		double full = 3.0 * (2 * s) * (lg + 1);
+		double split = 3.0 * s * lg + (s <= tuning().short_mulders_threshold ? 2 * convolve_low_cost(t - s / 2) : convolve_low_cost(2 * t - 1 - s));
+		return split * 1.1 < full ? split : full;
+	}
+	std::vector<modulo> convolve_low(std::vector<modulo> v1, std::vector<modulo> v2, int t) {
+		// Only the lowest t coefficients of convolve(v1, v2)
+		v1.resize(t); v2.resize(t);
+		std::vector<modulo> ans(t);
+		if (t <= tuning().short_direct_threshold) {
+			for (int i = 0; i < t; ++i) {
+				for (int j = 0; i + j < t; ++j) {
+					ans[i + j] += v1[i] * v2[j];
+				}
+			}
+			return ans;
+		}
+		int s = 1, lg = 0; while (s < t) s <<= 1, ++lg;
+		if (s > (1 << depth) || convolve_low_cost(t) >= 3.0 * (2 * s) * (lg + 1)) {
+			// The split part would be too large: a full product (transform size 2s) is cheaper
+			std::vector<modulo> full = convolve(v1, v2);
+			return std::vector<modulo>(full.begin(), full.begin() + t);
+		}
+		int k = s / 2, w = 2 * t - 1 - s;
+		if (s <= tuning().short_mulders_threshold) {
+			// Mulders' short product: full product of the lower k coefficients, plus two short products for the pairs above them
+			std::vector<modulo> lo = convolve(std::vector<modulo>(v1.begin(), v1.begin() + k), std::vector<modulo>(v2.begin(), v2.begin() + k));
+			std::vector<modulo> c1 = convolve_low(std::vector<modulo>(v1.begin() + k, v1.end()), v2, t - k);
+			std::vector<modulo> c2 = convolve_low(v1, std::vector<modulo>(v2.begin() + k, v2.end()), t - k);
+			for (int i = 0; i < t; ++i) {
+				ans[i] = lo[i];
+				if (i >= k) ans[i] += c1[i - k] + c2[i - k];
+			}
+			return ans;
+		}
+		// Convolution modulo x^s - 1 adds coefficient j + s onto coefficient j: the top w coefficients of the product are computed
+		// as a short product of the reversed vectors, and subtracted
+		std::vector<modulo> cyc = cyclic_convolve(v1, v2, s);
+		std::vector<modulo> hi = convolve_low(std::vector<modulo>(v1.rbegin(), v1.rbegin() + w), std::vector<modulo>(v2.rbegin(), v2.rbegin() + w), w);
+		for (int i = 0; i < t; ++i) {
+			ans[i] = cyc[i];
+			if (i < w) ans[i] -= hi[w - 1 - i];
+		}
+		return ans;
+	}
+	std::vector<modulo> convolve_high(std::vector<modulo> v1, std::vector<modulo> v2, int from) {
+		// Only the coefficients from x^from upwards of convolve(v1, v2), which are the lowest ones of the reversed convolution
+		int t = int(v1.size() + v2.size()) - 1 - from;
+		if (t <= 0) return std::vector<modulo>();
+		std::reverse(v1.begin(), v1.end());
+		std::reverse(v2.begin(), v2.end());
+		std::vector<modulo> ans = convolve_low(v1, v2, t);
+		std::reverse(ans.begin(), ans.end());
+		return ans;
+	}
+};
+
+#endif
+
+#ifndef ___CLASS_FFT
+#define ___CLASS_FFT
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+class fft {
+	// Complex Fast Fourier Transform in double precision, for convolutions of small integers (the split digits of bigint).
+	// Results are exact as long as the round-off error stays below 1/2, which is_safe() checks in advance by a proven bound.
+public:
+	using complex = std::complex<double>;
+private:
+	static constexpr int cached_roots = 1 << 16; // tables up to this size (1 MB) stay cached, larger ones only while in use
+	static std::shared_ptr<const std::vector<complex>> twiddles(int s) {
+		// Roots of unity: w[k + j] = exp(i * pi * j / k) for every power of two k < s and j < k.
+		// A table is never changed once built, so a transform keeps using the one it started with. Tables of up to cached_roots
+		// entries are kept for the life of the process; a larger one is only shared by the transforms running at the same time,
+		// and freed after the last of them, so a single large product doesn't leave it resident
+		static std::mutex m;
+		static std::shared_ptr<const std::vector<complex>> cache;
+		static std::weak_ptr<const std::vector<complex>> large;
+		std::lock_guard<std::mutex> lock(m);
+		if (cache != nullptr && int(cache->size()) >= s) return cache;
+		std::shared_ptr<const std::vector<complex>> table = large.lock();
+		if (table != nullptr && int(table->size()) >= s) return table;
+		// Every root is computed in long double from the roots of the level below, and rounded once, so the error of each is within 1 ulp
+		std::vector<complex> w(std::max(s, 2), complex(1));
+		std::vector<std::complex<long double>> prev(1, 1), cur;
+		for (int k = 2; k < s; k *= 2) {
+			std::complex<long double> x = std::polar(1.0L, std::acos(-1.0L) / k);
+			cur.resize(k);
+			for (int j = 0; j < k; ++j) {
+				cur[j] = (j & 1 ? prev[j / 2] * x : prev[j / 2]);
+				w[k + j] = complex(double(cur[j].real()), double(cur[j].imag()));
+			}
+			swap(prev, cur);
+		}
+		BIGINT_ALLOC(w.size() * sizeof(complex));
+		table = std::make_shared<const std::vector<complex>>(std::move(w));
+		if (s <= cached_roots) cache = table;
+		else large = table;
+		return table;
+	}
+public:
+	static double error_bound(int depth, double norm) {
+		// Percival's bound on the error of a convolution through transforms of size 2^depth, where norm = |x|_2 * |y|_2:
+		// norm * ((1 + e)^3d * (1 + e * sqrt(5))^(3d + 1) * (1 + b)^3d - 1), with e = 2^-53 the rounding unit and b = 2^-52 the error of the roots
+		const double e = std::ldexp(1.0, -53), b = std::ldexp(1.0, -52);
+		long double f = std::pow(1.0L + e, 3.0L * depth) * std::pow(1.0L + e * std::sqrt(5.0L), 3.0L * depth + 1) * std::pow(1.0L + b, 3.0L * depth) - 1;
+		return double(norm * f);
+	}
+	static bool is_safe(double norm2, int s) {
+		// Whether a product of two sequences with |x|_2^2 + |y|_2^2 = norm2, through transforms of size s, rounds to the exact result.
+		// convolve() squares z = x + iy and halves the imaginary part, so its error is at most error_bound(|z|_2^2) / 2; a margin of 2 is kept
+		int depth = 0;
+		while ((1 << depth) < s) ++depth;
+		return error_bound(depth, norm2) / 2 < 0.25;
+	}
+	void fourier_transform(std::vector<complex>& v) { fourier_transform(v, *twiddles(v.size())); }
+	void fourier_transform(std::vector<complex>& v, const std::vector<complex>& table) {
+		// In place, forward (the inverse is done by the caller by reversing the input), with a table of twiddles() of at least v.size()
+		int s = v.size();
+		BIGINT_COUNT(instrument::op_fourier_transform);
+		BIGINT_TRANSFORM(s);
+		const complex* w = table.data();
+		for (int i = 0, j = 1; j < s - 1; ++j) {
+			for (int k = s >> 1; k > (i ^= k); k >>= 1);
+			if (i < j) std::swap(v[i], v[j]);
+		}
+		double* p = reinterpret_cast<double*>(v.data());
+		for (int k = 1; k < s; k *= 2) {
+			for (int i = 0; i < s; i += 2 * k) {
+				for (int j = 0; j < k; ++j) {
+					// Multiplication written out: std::complex's operator* also handles infinities and NaN, and is much slower
+					double* x = p + 2 * (i + j);
+					double* y = p + 2 * (i + j + k);
+					double wr = w[j + k].real(), wi = w[j + k].imag();
+					double zr = wr * y[0] - wi * y[1], zi = wr * y[1] + wi * y[0];
+					y[0] = x[0] - zr, y[1] = x[1] - zi;
+					x[0] += zr, x[1] += zi;
+				}
+			}
+		}
+	}
+	std::vector<long long> convolve(const std::vector<int>& v1, const std::vector<int>& v2) {
+		// Exact if is_safe(|v1|_2^2 + |v2|_2^2, s) for the transform size s >= v1.size() + v2.size() - 1.
+		// v1 and v2 are packed into one complex sequence z = v1 + i * v2, whose square has 2 * v1 * v2 as its imaginary part
+		BIGINT_COUNT(instrument::op_convolve);
+		int n = v1.size() + v2.size() - 1, s = 1;
+		while (s < n) s <<= 1;
+		// The roots first: their construction needs more memory than the table itself, which is then not taken with z and out
+		std::shared_ptr<const std::vector<complex>> table = twiddles(s);
+		std::vector<complex> z(s), out(s);
+		BIGINT_ALLOC(2 * s * sizeof(complex));
+		for (int i = 0; i < v1.size(); ++i) z[i].real(v1[i]);
+		for (int i = 0; i < v2.size(); ++i) z[i].imag(v2[i]);
+		{
+			BIGINT_PHASE(instrument::phase_forward);
+			fourier_transform(z, *table);
+		}
+		{
+			// The inverse transform of Z^2 is a forward transform of the conjugates in reverse order; subtracting
+			// conj(Z^2) there leaves only the imaginary part (2 * v1 * v2) of the result
+			BIGINT_PHASE(instrument::phase_pointwise);
+			for (complex& x : z) {
+				double r = x.real(), i = x.imag();
+				x = complex(r * r - i * i, 2 * r * i);
+			}
+			for (int i = 0; i < s; ++i) out[i] = z[-i & (s - 1)] - std::conj(z[i]);
+		}
+		{
+			BIGINT_PHASE(instrument::phase_inverse);
+			fourier_transform(out, *table);
+		}
+		std::vector<long long> ans(n);
+		for (int i = 0; i < n; ++i) ans[i] = std::llround(out[i].imag() / (4.0 * s));
+		return ans;
+	}
 };
 
+inline fft fft_base;
+
 #endif
 
 #ifndef __CLASS_BASICINTEGER
 #define __CLASS_BASICINTEGER
 
+#include <algorithm>
+#include <functional>
+#include <string>
 #include <vector>
 
-using modulo1 = modint<469762049, 3>; ntt<modulo1> ntt_base1;
-using modulo2 = modint<167772161, 3>; ntt<modulo2> ntt_base2;
+// The engines have no state and are constant-initialized, so any number of translation units and threads can share them
+using modulo1 = modint<469762049, 3>; inline ntt<modulo1> ntt_base1;
+using modulo2 = modint<167772161, 3>; inline ntt<modulo2> ntt_base2;
 
-const modulo1 magic_inv = modulo1(modulo2::get_mod()).binpow(modulo1::get_mod() - 2);
+inline constexpr modulo1 magic_inv = modulo1(modulo2::get_mod()).binpow(modulo1::get_mod() - 2);
+
+struct multiply_plan {
+	// How basic_integer::multiply(b, plan) computes a product, chosen by plan_multiply() to fit a memory budget
+	enum class method { standard, in_place, block };
+	method how;
+	int block_limbs; // for method::block, the size of the blocks of both operands
+	uint64_t peak_bytes; // estimated peak of the memory held during the product, including both operands and the result
+	uint64_t budget_bytes;
+	bool fits() const { return budget_bytes == 0 || peak_bytes <= budget_bytes; }
+	std::string to_string() const {
+		std::string name = (how == method::standard ? "standard" : how == method::in_place ? "in_place" : "block");
+		if (how == method::block) name += " (" + std::to_string(block_limbs) + " limbs)";
+		return name + ", estimated peak " + std::to_string(peak_bytes) + " bytes" + (budget_bytes != 0 ? " of budget " + std::to_string(budget_bytes) : "") + (fits() ? "" : " (over budget)");
+	}
+};
+inline std::function<void(const multiply_plan&)>& multiply_plan_observer() {
+	// If set, called with the plan of every product made under tuning().memory_budget_mb, before the product runs
+	// (e.g. [](const multiply_plan& p) { std::cerr << p.to_string() << std::endl; }). Set it like tuning(): while no other thread computes
+	static std::function<void(const multiply_plan&)> observer;
+	return observer;
+}
 
 template<int base>
 class basic_integer {
@@ -165,10 +853,9 @@ public:
 	int size() const { return a.size(); }
 	int nth_digit(int n) const { return a[n]; }
 	basic_integer& resize() {
-		int lim = 1;
-		for (int i = 0; i < a.size(); ++i) {
-			if (a[i] != 0) lim = i + 1;
-		}
+		// Drops leading zeros, scanning down from the top: only the zeros themselves are read
+		int lim = a.size();
+		while (lim > 1 && a[lim - 1] == 0) --lim;
 		a.resize(lim);
 		return *this;
 	}
@@ -190,15 +877,80 @@ public:
 		}
 		return *this;
 	}
-	bool operator==(const basic_integer& b) const { return a == b.a; }
-	bool operator!=(const basic_integer& b) const { return a != b.a; }
-	bool operator<(const basic_integer& b) const {
-		if (a.size() != b.a.size()) return a.size() < b.a.size();
-		for (int i = a.size() - 1; i >= 0; --i) {
-			if (a[i] != b.a[i]) return a[i] < b.a[i];
+	// Carry kernels for normalized limbs. The sum of two limbs is less than 2 * base, so a carry is a comparison and a
+	// conditional subtraction, without dividing. Blocks of 64 limbs are done by carry-lookahead: every limb takes the carry
+	// generated by the limb below it, which is independent across the block and vectorizes, and the rare limbs that
+	// then reach base (a carry passed through a limb of base - 1) are fixed afterwards.
+	static int add_limbs(int* x, const int* y, int n, int carry) {
+		// x[0..n) += y[0..n) + carry, returns the carry out
+		int i = 0;
+		for (; i + 64 <= n; i += 64) {
+			int* xs = x + i;
+			const int* ys = y + i;
+			int s[64];
+			unsigned char g[65];
+			g[0] = carry;
+			for (int k = 0; k < 64; ++k) s[k] = xs[k] + ys[k], g[k + 1] = (s[k] >= base);
+			int over = 0;
+			for (int k = 0; k < 64; ++k) {
+				xs[k] = s[k] - (g[k + 1] ? base : 0) + g[k];
+				over |= (xs[k] == base);
+			}
+			carry = g[64];
+			for (int k = 0; k < 64 && over; ++k) {
+				if (xs[k] != base) continue;
+				xs[k] = 0;
+				if (k + 1 < 64) ++xs[k + 1];
+				else carry = 1;
+			}
+		}
+		for (; i < n; ++i) {
+			int v = x[i] + y[i] + carry;
+			carry = (v >= base);
+			x[i] = v - (carry ? base : 0);
+		}
+		return carry;
+	}
+	static int sub_limbs(int* x, const int* y, int n, int borrow) {
+		// x[0..n) -= y[0..n) + borrow, returns the borrow out
+		int i = 0;
+		for (; i + 64 <= n; i += 64) {
+			int* xs = x + i;
+			const int* ys = y + i;
+			int s[64];
+			unsigned char g[65];
+			g[0] = borrow;
+			for (int k = 0; k < 64; ++k) s[k] = xs[k] - ys[k], g[k + 1] = (s[k] < 0);
+			int under = 0;
+			for (int k = 0; k < 64; ++k) {
+				xs[k] = s[k] + (g[k + 1] ? base : 0) - g[k];
+				under |= (xs[k] < 0);
+			}
+			borrow = g[64];
+			for (int k = 0; k < 64 && under; ++k) {
+				if (xs[k] >= 0) continue;
+				xs[k] = base - 1;
+				if (k + 1 < 64) --xs[k + 1];
+				else borrow = 1;
+			}
+		}
+		for (; i < n; ++i) {
+			int v = x[i] - y[i] - borrow;
+			borrow = (v < 0);
+			x[i] = v + (borrow ? base : 0);
 		}
-		return false;
+		return borrow;
 	}
+	int compare(const basic_integer& b) const {
+		// -1, 0 or 1 as *this is less than, equal to or greater than b
+		if (a.size() != b.a.size()) return a.size() < b.a.size() ? -1 : 1;
+		auto it = std::mismatch(a.rbegin(), a.rend(), b.a.rbegin());
+		if (it.first == a.rend()) return 0;
+		return *it.first < *it.second ? -1 : 1;
+	}
+	bool operator==(const basic_integer& b) const { return a == b.a; }
+	bool operator!=(const basic_integer& b) const { return a != b.a; }
+	bool operator<(const basic_integer& b) const { return compare(b) < 0; }
 	bool operator>(const basic_integer& b) const { return b < (*this); }
 	bool operator<=(const basic_integer& b) const { return !((*this) > b); }
 	bool operator>=(const basic_integer& b) const { return !((*this) < b); }
@@ -217,18 +969,28 @@ public:
 	}
 	basic_integer& operator+=(const basic_integer& b) {
 		if (a.size() < b.a.size()) a.resize(b.a.size(), 0);
-		for (int i = 0; i < b.a.size(); ++i) a[i] += b.a[i];
-		return (*this).shift();
+		int carry = add_limbs(a.data(), b.a.data(), b.a.size(), 0);
+		for (int i = b.a.size(); i < a.size() && carry; ++i) {
+			carry = (a[i] == base - 1);
+			a[i] = (carry ? 0 : a[i] + 1);
+		}
+		if (carry) a.push_back(1);
+		return *this;
 	}
 	basic_integer& operator-=(const basic_integer& b) {
-		for (int i = 0; i < b.a.size(); ++i) a[i] -= b.a[i];
-		return (*this).shift().resize();
+		// Requires *this >= b. The borrow stops at the first nonzero limb above b, and only the top can become zero
+		int borrow = sub_limbs(a.data(), b.a.data(), b.a.size(), 0);
+		for (int i = b.a.size(); i < a.size() && borrow; ++i) {
+			borrow = (a[i] == 0);
+			a[i] = (borrow ? base - 1 : a[i] - 1);
+		}
+		return (*this).resize();
 	}
-	basic_integer& operator*=(const basic_integer& b) {
-		std::vector<modulo1> mul_base1 = ntt_base1.convolve(get_modvector<modulo1>(a), get_modvector<modulo1>(b.a));
-		std::vector<modulo2> mul_base2 = ntt_base2.convolve(get_modvector<modulo2>(a), get_modvector<modulo2>(b.a));
+	basic_integer& assign_convolution(const std::vector<modulo1>& mul_base1, const std::vector<modulo2>& mul_base2) {
+		BIGINT_PHASE(instrument::phase_crt);
 		const int margin = 20;
 		a = std::vector<int>(mul_base1.size() + margin);
+		BIGINT_ALLOC(a.size() * sizeof(int));
 		for (int i = 0; i < a.size() - margin; ++i) {
 			// s * p1 + a1 = val = t * p2 + a2's solution is t = (a1 - a2) / p2 (mod p1)
 			long long val = (long long)(((mul_base1[i] - modulo1(mul_base2[i].get())) * magic_inv).get()) * modulo2::get_mod() + mul_base2[i].get();
@@ -243,13 +1005,276 @@ public:
 		}
 		return (*this).resize();
 	}
+	static constexpr int fft_split() {
+		// Limbs are split into two digits of base sqrt(base) for the FFT, or the FFT is not used (0) if base is not a square
+		int r = 1;
+		while ((r + 1) * (r + 1) <= base) ++r;
+		return r * r == base ? r : 0;
+	}
+	static std::vector<int> get_fft_digits(const std::vector<int>& a, double& norm2) {
+		// Balanced digits in [-d/2, d/2), which make the round-off error of the FFT much smaller; norm2 += the sum of their squares.
+		// The top digit stays in [0, d], so the number of digits (and the transform size) doesn't grow
+		const int d = fft_split();
+		std::vector<int> v(2 * a.size());
+		int carry = 0;
+		for (int i = 0; i < a.size(); ++i) {
+			int x = a[i] + carry, lo = x % d, hi = x / d;
+			if (lo >= d / 2) lo -= d, ++hi;
+			carry = (hi >= d / 2 && i + 1 < a.size());
+			if (carry) hi -= d;
+			v[2 * i] = lo, v[2 * i + 1] = hi;
+		}
+		while (v.size() > 1 && v.back() == 0) v.pop_back();
+		for (int x : v) norm2 += double(x) * x;
+		return v;
+	}
+	basic_integer& assign_fft_product(const std::vector<long long>& c) {
+		BIGINT_PHASE(instrument::phase_crt);
+		const int d = fft_split();
+		a.assign((c.size() + 1) / 2, 0);
+		BIGINT_ALLOC(a.size() * sizeof(int));
+		long long carry = 0;
+		for (int i = 0; i < a.size(); ++i) {
+			long long v = carry + c[2 * i] + (2 * i + 1 < c.size() ? c[2 * i + 1] * d : 0);
+			long long q = v / base, r = v % base;
+			if (r < 0) r += base, --q;
+			a[i] = r, carry = q;
+		}
+		for (; carry > 0; carry /= base) a.push_back(carry % base);
+		return (*this).resize();
+	}
+	static bool use_fft(int n1, int n2) {
+		// The multiplication engine by size: the FFT in the range of the tuning table, the NTT elsewhere
+		// (for unbalanced operands, the NTT splits the larger one into blocks and is faster)
+		const tuning_table& t = tuning();
+		int lo = std::min(n1, n2), hi = std::max(n1, n2);
+		return fft_split() != 0 && lo >= t.fft_min_limbs && n1 + n2 <= t.fft_max_limbs && hi <= (long long)t.fft_max_ratio * lo;
+	}
+	bool multiply_fft(const basic_integer& b) {
+		// *this *= b by the FFT, if its error bound proves the result exact for these operands; otherwise returns false and leaves *this unchanged
+		double norm2 = 0;
+		std::vector<int> v1 = get_fft_digits(a, norm2), v2 = (&b == this ? v1 : get_fft_digits(b.a, norm2));
+		if (&b == this) norm2 *= 2;
+		int s = 1;
+		while (s < v1.size() + v2.size() - 1) s <<= 1;
+		if (!fft::is_safe(norm2, s)) return false;
+		(*this).assign_fft_product(fft_base.convolve(v1, v2));
+		return true;
+	}
+	basic_integer& operator*=(const basic_integer& b) {
+		if (tuning().memory_budget_mb != 0) {
+			multiply_plan plan = plan_multiply(a.size(), b.a.size(), uint64_t(tuning().memory_budget_mb) << 20);
+			BIGINT_PLAN(int(plan.how), plan.peak_bytes, plan.fits());
+			if (multiply_plan_observer()) multiply_plan_observer()(plan);
+			if (plan.how != multiply_plan::method::standard) return (*this).multiply(b, plan);
+		}
+		BIGINT_COUNT(instrument::op_multiply);
+		if (use_fft(a.size(), b.a.size()) && (*this).multiply_fft(b)) return *this;
+		std::vector<modulo1> mul_base1 = ntt_base1.convolve(get_modvector<modulo1>(a), get_modvector<modulo1>(b.a));
+		std::vector<modulo2> mul_base2 = ntt_base2.convolve(get_modvector<modulo2>(a), get_modvector<modulo2>(b.a));
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	static uint64_t pow2_at_least(uint64_t n) {
+		uint64_t s = 1;
+		while (s < n) s <<= 1;
+		return s;
+	}
+	static uint64_t standard_peak(uint64_t n1, uint64_t n2) {
+		// Estimated peak of operator*= (both operands and the result included), following its buffers
+		if (n1 < n2) std::swap(n1, n2);
+		if (use_fft(n1, n2)) {
+			// digits (int), two complex sequences, the coefficients (long long), and the roots of unity: built for the product above
+			// fft::cached_roots entries, before the sequences (so the two long double levels of the construction, 24 bytes per
+			// entry, don't coincide with them), and else cached, then counted once at the size of the product
+			uint64_t d = 2 * (n1 + n2), s = pow2_at_least(d);
+			return 4 * (n1 + n2) + 4 * d + 48 * s + 8 * d;
+		}
+		// Second modulus: the first result, the modvectors, the copy of the larger one, the spectrum and the buffer it was
+		// transformed in (a by-value argument, freed after the whole call), the result, and one block with its copy while it is widened
+		uint64_t s2 = pow2_at_least(n2), s1 = s2;
+		while (s1 < n1) s1 <<= 1;
+		uint64_t ntt_stage = 4 * (s1 + s2) + 4 * (n1 + n2) + 4 * s1 + 16 * s2 + 4 * (s1 + s2) + 12 * s2;
+		uint64_t crt_stage = 12 * (s1 + s2) + 4 * n2;
+		return 4 * (n1 + n2) + std::max(ntt_stage, crt_stage);
+	}
+	static uint64_t in_place_peak(uint64_t n1, uint64_t n2) {
+		// multiply_in_place(): the larger of the first modulus (operands, two buffers) and the second (b, three buffers)
+		uint64_t s = pow2_at_least(n1 + n2 - 1);
+		return std::max(4 * (n1 + n2) + 8 * s, 4 * n2 + 12 * s);
+	}
+	static uint64_t block_peak(uint64_t n1, uint64_t n2, uint64_t k) {
+		// multiply_blocks(): the operands, the result, and two blocks with their in-place product
+		k = std::min<uint64_t>(k, std::max(n1, n2));
+		return 8 * (n1 + n2) + 12 * k + in_place_peak(k, k);
+	}
+	static multiply_plan plan_multiply(int n1, int n2, uint64_t budget_bytes) {
+		// The fastest method whose estimated peak fits the budget (0: no limit): the standard product, then the in-place one,
+		// then blocks as large as fit. Blocks are at least 64 limbs and 1/32 of the larger operand, so a block plan is never much
+		// slower than the standard product. If nothing fits, the plan is the in-place product (or the standard one, when the product
+		// is too long for the in-place transforms) with fits() == false: the smallest peak short of tiny blocks, and the overrun is reported
+		multiply_plan plan = { multiply_plan::method::standard, 0, standard_peak(n1, n2), budget_bytes };
+		if (plan.fits()) return plan;
+		multiply_plan fallback = plan;
+		if (pow2_at_least(n1 + n2 - 1) <= (1 << 25)) {
+			plan.how = multiply_plan::method::in_place;
+			plan.peak_bytes = in_place_peak(std::max(n1, n2), std::min(n1, n2));
+			if (plan.fits()) return plan;
+			fallback = plan;
+		}
+		int min_block = std::max(64, std::max(n1, n2) / 32), k = 1 << 23;
+		while (k / 2 >= min_block && block_peak(n1, n2, k) > budget_bytes) k >>= 1;
+		if (block_peak(n1, n2, k) > budget_bytes) return fallback;
+		plan.how = multiply_plan::method::block;
+		plan.block_limbs = k;
+		plan.peak_bytes = block_peak(n1, n2, k);
+		return plan;
+	}
+	basic_integer& multiply_in_place(const basic_integer& b) {
+		// NTT product with the fewest buffers: one cyclic transform per operand and modulus at the size of the product, taken in
+		// place, with the pointwise products in the buffer of *this. The limbs of *this are released once both moduli have read them,
+		// and the CRT streams each coefficient into the buffer of the first modulus with a 64-bit carry, so no margin or third array is needed
+		BIGINT_COUNT(instrument::op_multiply);
+		int n = a.size() + b.a.size() - 1, s = pow2_at_least(n);
+		bool same = (&b == this);
+		std::vector<modulo1> r1(s);
+		std::vector<modulo2> r2(s);
+		BIGINT_ALLOC(s * (sizeof(modulo1) + sizeof(modulo2)));
+		for (int i = 0; i < a.size(); ++i) r1[i] = a[i], r2[i] = a[i];
+		if (!same) std::vector<int>().swap(a);
+		ntt_base1.fourier_transform(r1, false);
+		{
+			std::vector<modulo1> t(same ? 0 : s);
+			for (int i = 0; i < t.size() && i < b.a.size(); ++i) t[i] = b.a[i];
+			if (!same) ntt_base1.fourier_transform(t, false);
+			for (int i = 0; i < s; ++i) r1[i] *= (same ? r1[i] : t[i]);
+		}
+		ntt_base1.fourier_transform(r1, true);
+		ntt_base2.fourier_transform(r2, false);
+		{
+			std::vector<modulo2> t(same ? 0 : s);
+			for (int i = 0; i < t.size() && i < b.a.size(); ++i) t[i] = b.a[i];
+			if (!same) ntt_base2.fourier_transform(t, false);
+			for (int i = 0; i < s; ++i) r2[i] *= (same ? r2[i] : t[i]);
+		}
+		ntt_base2.fourier_transform(r2, true);
+		if (same) std::vector<int>().swap(a);
+		BIGINT_PHASE(instrument::phase_crt);
+		uint64_t carry = 0;
+		for (int i = 0; i < s; ++i) {
+			uint64_t val = uint64_t(((r1[i] - modulo1(r2[i].get())) * magic_inv).get()) * modulo2::get_mod() + r2[i].get();
+			carry += val;
+			r1[i] = modulo1(carry % base);
+			carry /= base;
+		}
+		std::vector<modulo2>().swap(r2);
+		a.assign(n + 1, 0);
+		for (int i = 0; i < s && i <= n; ++i) a[i] = r1[i].get();
+		for (int i = s; carry > 0; ++i) a[i] = carry % base, carry /= base;
+		return (*this).resize();
+	}
+	basic_integer& multiply_blocks(const basic_integer& b, int k) {
+		// Schoolbook over blocks of k limbs of both operands, every block product in place: beyond the operands and
+		// the result, the memory is proportional to k
+		std::vector<int> out(a.size() + b.a.size() + 1, 0);
+		for (int i = 0; i < a.size(); i += k) {
+			basic_integer x(std::vector<int>(a.begin() + i, a.begin() + std::min<int>(i + k, a.size())));
+			if (x.resize().a == std::vector<int>({ 0 })) continue;
+			for (int j = 0; j < b.a.size(); j += k) {
+				basic_integer p(std::vector<int>(b.a.begin() + j, b.a.begin() + std::min<int>(j + k, b.a.size())));
+				if (p.resize().a == std::vector<int>({ 0 })) continue;
+				p.multiply_in_place(x);
+				int carry = add_limbs(out.data() + i + j, p.a.data(), p.a.size(), 0);
+				for (int l = i + j + p.a.size(); carry; ++l) {
+					carry = (out[l] == base - 1);
+					out[l] = (carry ? 0 : out[l] + 1);
+				}
+			}
+		}
+		a.swap(out);
+		return (*this).resize();
+	}
+	basic_integer& multiply(const basic_integer& b, const multiply_plan& plan) {
+		if (plan.how == multiply_plan::method::in_place) return (*this).multiply_in_place(b);
+		if (plan.how == multiply_plan::method::block) return (*this).multiply_blocks(b, plan.block_limbs);
+		return (*this) *= b;
+	}
+	static bool short_product_pays(int n1, int n2, int t) {
+		// Whether the top t coefficients of an n1 x n2 product are cheaper by convolve_high() than by the full product and a shift.
+		// The estimate has to be clearly below that of the full NTT product, and more so in the range of the FFT, which is faster
+		int s = 1, lg = 0;
+		while (s < n1 + n2 - 1) s <<= 1, ++lg;
+		return ntt<modulo1>::convolve_low_cost(t) < 3.0 * s * lg * (use_fft(n1, n2) ? 0.6 : 0.9);
+	}
+	static basic_integer mul_high(const basic_integer& x, const basic_integer& y, int p) {
+		// Approximates the highest p digits of x * y: with k = x.size() + y.size() - p, the result r satisfies
+		// floor(x * y / base^k) - 1 <= r <= floor(x * y / base^k). Only the coefficients from x^(k - g) upwards are computed,
+		// where the g guard digits absorb the dropped partial products (at most min(x.size(), y.size()) of them per digit).
+		BIGINT_COUNT(instrument::op_mul_high);
+		int k = x.size() + y.size() - p;
+		if (k <= 0) return x * y;
+		int g = 1;
+		for (long long c = 1; c < std::min(x.size(), y.size()); c *= base) ++g;
+		int from = std::max(k - g, 0);
+		if (!short_product_pays(x.size(), y.size(), x.size() + y.size() - 1 - from)) return (x * y) >>= k;
+		basic_integer ans;
+		ans.assign_convolution(ntt_base1.convolve_high(get_modvector<modulo1>(x.a), get_modvector<modulo1>(y.a), from),
+			ntt_base2.convolve_high(get_modvector<modulo2>(x.a), get_modvector<modulo2>(y.a), from));
+		return ans >>= (k - from);
+	}
+	struct spectrum {
+		// A transformed operand, which can be multiplied many times while paying its forward transforms only once
+		ntt<modulo1>::spectrum s1;
+		ntt<modulo2>::spectrum s2;
+	};
+	spectrum get_spectrum() const {
+		return spectrum{ ntt_base1.get_spectrum(get_modvector<modulo1>(a)), ntt_base2.get_spectrum(get_modvector<modulo2>(a)) };
+	}
+	basic_integer& multiply(const spectrum& sp) {
+		std::vector<modulo1> mul_base1 = ntt_base1.convolve_spectrum(get_modvector<modulo1>(a), sp.s1);
+		std::vector<modulo2> mul_base2 = ntt_base2.convolve_spectrum(get_modvector<modulo2>(a), sp.s2);
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	basic_integer& square() {
+		BIGINT_COUNT(instrument::op_square);
+		if (use_fft(a.size(), a.size()) && (*this).multiply_fft(*this)) return *this;
+		std::vector<modulo1> mul_base1 = ntt_base1.square(get_modvector<modulo1>(a));
+		std::vector<modulo2> mul_base2 = ntt_base2.square(get_modvector<modulo2>(a));
+		return (*this).assign_convolution(mul_base1, mul_base2);
+	}
+	basic_integer& pow(uint64_t n) {
+		// Left-to-right binary powering multiplies by the base only, so the base is transformed once and every step costs one forward transform per squaring.
+		// For tiny exponents or huge bases there is nothing to reuse, and right-to-left (square the base, multiply into the result) is used.
+		const int spectrum_limit = 1 << 22;
+		if (n == 0) return (*this) = basic_integer({ 1 });
+		if (n < 4 || a.size() > spectrum_limit) {
+			basic_integer cur = *this;
+			(*this) = basic_integer({ 1 });
+			while (true) {
+				if (n & 1) (*this) *= cur;
+				n >>= 1;
+				if (n == 0) break;
+				cur.square();
+			}
+			return *this;
+		}
+		spectrum sp = get_spectrum();
+		int bit = 63;
+		while (!(n >> bit & 1)) --bit;
+		for (--bit; bit >= 0; --bit) {
+			(*this).square();
+			if (n >> bit & 1) (*this).multiply(sp);
+		}
+		return *this;
+	}
 	basic_integer& operator/=(const basic_integer& b) {
+		BIGINT_COUNT(instrument::op_divide);
+		if (a.size() < b.a.size()) return (*this) = basic_integer();
 		int preci = a.size() - b.a.size();
 		basic_integer t({ 1 });
 		basic_integer two = basic_integer({ 2 }) << b.a.size();
 		basic_integer pre;
-		int lim = std::min(preci, 3);
-		int blim = std::min(int(b.a.size()), 6);
+		int lim = std::min(preci, tuning().div_seed_quotient);
+		int blim = std::min(int(b.a.size()), tuning().div_seed_divisor);
 		t <<= lim;
 		while (pre != t) {
 			basic_integer rb = b >> (b.a.size() - blim);
@@ -281,21 +1306,25 @@ public:
 		(*this) = ans.resize();
 		return *this;
 	}
+	basic_integer& operator%=(const basic_integer& b) {
+		return (*this) -= (*this) / b * b;
+	}
 	basic_integer& divide_by_2() {
-		for (int i = a.size() - 1; i >= 0; --i) {
-			int carry = a[i] % 2;
-			a[i] /= 2;
-			if (i != 0) a[i - 1] += carry * base;
-		}
-		if (a.size() >= 2 && a.back() == 0) a.pop_back();
+		// With an even base, limb i of the half is a[i] / 2 plus base / 2 if a[i + 1] is odd: no limb depends on another result
+		static_assert(base % 2 == 0, "divide_by_2 needs an even base");
+		int n = a.size();
+		for (int i = 0; i + 1 < n; ++i) a[i] = (a[i] >> 1) + (a[i + 1] & 1) * (base / 2);
+		a[n - 1] >>= 1;
+		if (n >= 2 && a.back() == 0) a.pop_back();
 		return *this;
 	}
 	basic_integer operator<<(int x) const { return basic_integer(*this) <<= x; }
-	basic_integer operator >> (int x) const { return basic_integer(*this) >>= x; }
+	basic_integer operator>>(int x) const { return basic_integer(*this) >>= x; }
 	basic_integer operator+(const basic_integer& b) const { return basic_integer(*this) += b; }
 	basic_integer operator-(const basic_integer& b) const { return basic_integer(*this) -= b; }
 	basic_integer operator*(const basic_integer& b) const { return basic_integer(*this) *= b; }
 	basic_integer operator/(const basic_integer& b) const { return basic_integer(*this) /= b; }
+	basic_integer operator%(const basic_integer& b) const { return basic_integer(*this) %= b; }
 };
 
 #endif
@@ -313,6 +1342,7 @@ const int digit_base = 10000;
 class bigint : public basic_integer<digit_base> {
 public:
 	bigint() { a = std::vector<int>({ 0 }); };
+	bigint(const basic_integer& x) : basic_integer(x) {};
 	bigint(long long x) {
 		a.clear();
 		for (int i = 0; x > 0; ++i) {
@@ -322,6 +1352,7 @@ public:
 		if (a.size() == 0) a = { 0 };
 	}
 	bigint(const std::string& s) {
+		BIGINT_COUNT(instrument::op_parse);
 		a.clear();
 		for (int i = 0; digit * i < s.size(); ++i) {
 			a.push_back(std::stoi(s.substr(std::max(int(s.size()) - i * digit - digit, 0), digit - std::max(digit + i * digit - int(s.size()), 0))));
@@ -329,6 +1360,7 @@ public:
 		if (a.size() == 0) a = { 0 };
 	}
 	std::string to_string() const {
+		BIGINT_COUNT(instrument::op_print);
 		std::string ret;
 		bool flag = false;
 		for (int i = a.size() - 1; i >= 0; --i) {
@@ -349,24 +1381,79 @@ public:
 	bigint& operator>>=(int x) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) >>= x); }
 	bigint& operator+=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) += basic_integer(b)); }
 	bigint& operator-=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) -= basic_integer(b)); }
-	bigint& operator*=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) *= basic_integer(b)); }
+	bigint& operator*=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) *= reinterpret_cast<const basic_integer&>(b.a)); }
 	bigint& operator/=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) /= basic_integer(b)); }
+	bigint& operator%=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) %= basic_integer(b)); }
+	bigint& multiply(const spectrum& sp) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).multiply(sp)); }
+	bigint& multiply(const bigint& b, const multiply_plan& plan) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).multiply(b, plan)); }
+	bigint& square() { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).square()); }
+	bigint& pow(uint64_t n) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).pow(n)); }
 	bigint& divide_by_2() { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).divide_by_2()); }
 	bigint operator<<(int x) const { return bigint(*this) <<= x; }
-	bigint operator >> (int x) const { return bigint(*this) >>= x; }
+	bigint operator>>(int x) const { return bigint(*this) >>= x; }
 	bigint operator+(const bigint& b) const { return bigint(*this) += b; }
 	bigint operator-(const bigint& b) const { return bigint(*this) -= b; }
 	bigint operator*(const bigint& b) const { return bigint(*this) *= b; }
 	bigint operator/(const bigint& b) const { return bigint(*this) /= b; }
-	friend std::istream& operator >> (std::istream& is, bigint& x) { std::string s; is >> s; x = bigint(s); return is; }
+	bigint operator%(const bigint& b) const { return bigint(*this) %= b; }
+	friend std::istream& operator>>(std::istream& is, bigint& x) { std::string s; is >> s; x = bigint(s); return is; }
 	friend std::ostream& operator<<(std::ostream& os, const bigint& x) { os << x.to_string(); return os; }
 };
 
+inline bigint pow(const bigint& x, uint64_t n) { return bigint(x).pow(n); }
+inline bigint sqrt(const bigint& x) {
+	// floor(sqrt(x)) by Newton's method on the highest 2 * scale digits of x, doubling scale each step. At the first and the last
+	// scale the steps run until they stop decreasing: one step from any a > 0 gives at least floor(sqrt), and from there the steps
+	// decrease down to it. Stopping only when a step repeats could alternate between two values forever (99 and 100 for 9999)
+	if (x == bigint(0)) return x;
+	int max_scale = (x.size() + 1) / 2;
+	int scale = std::min(4, max_scale);
+	auto step = [&](const bigint& a) {
+		bigint xd = x;
+		if (x.size() > 2 * scale) xd >>= (x.size() - 2 * scale + x.size() % 2);
+		return (a + xd / a).divide_by_2();
+	};
+	auto descend = [&](bigint a) {
+		a = step(a);
+		for (bigint next = step(a); next < a; next = step(a)) a = next;
+		return a;
+	};
+	bigint a = descend(bigint(1) << (scale - 1));
+	while (scale < max_scale) {
+		a = step(a);
+		int next_scale = std::min(max_scale, scale * 2);
+		a <<= next_scale - scale;
+		scale = next_scale;
+	}
+	return descend(a);
+}
+
 #endif
 
 #ifndef ___CLASS_NEWBIGFLOAT
 #define ___CLASS_NEWBIGFLOAT
 
+enum class rounding { truncate, nearest, up };
+
+struct precision_context {
+	int limbs; // digits (in D-ary) kept in the mantissa after every operation; 0 means exact
+	rounding mode;
+};
+inline precision_context& bigfloat_precision() {
+	thread_local precision_context context = { 0, rounding::nearest };
+	return context;
+}
+class precision_guard {
+	// Sets the precision of the current thread, until the guard goes out of scope
+private:
+	precision_context saved;
+public:
+	precision_guard(int limbs, rounding mode = rounding::nearest) : saved(bigfloat_precision()) { bigfloat_precision() = precision_context{ limbs, mode }; }
+	~precision_guard() { bigfloat_precision() = saved; }
+	precision_guard(const precision_guard&) = delete;
+	precision_guard& operator=(const precision_guard&) = delete;
+};
+
 class bigfloat {
 private:
 	bigint b;
@@ -385,45 +1472,146 @@ public:
 	}
 	bigfloat& operator<<=(int x) { scale += x; return *this; }
 	bigfloat& operator>>=(int x) { scale -= x; return *this; }
-	bigfloat& operator+=(const bigfloat& f) {
-		if (scale > f.scale) (*this).set_scale(f.scale), (*this).b += f.b;
-		else {
-			bigint delta = f.b << (f.scale - scale);
-			(*this).b += delta;
+	bool is_zero() const { return b.size() == 1 && b.nth_digit(0) == 0; }
+	int top() const { return scale + b.size(); } // the value is less than D^top()
+	bigfloat& round(int preci, rounding mode) {
+		// Keeps the highest preci digits (in D-ary) of the mantissa, rounding the rest away
+		if (preci <= 0 || b.size() <= preci) return *this;
+		int drop = b.size() - preci;
+		bool carry = false;
+		if (mode == rounding::nearest) carry = (b.nth_digit(drop - 1) >= digit_base / 2);
+		if (mode == rounding::up) {
+			for (int i = 0; i < drop && !carry; ++i) carry = (b.nth_digit(i) != 0);
 		}
+		b >>= drop;
+		scale += drop;
+		if (carry) {
+			b += bigint(1);
+			if (b.size() > preci) b >>= 1, ++scale; // 99...9 + 1 = 100...0, dropping a zero digit is exact
+		}
+		return *this;
+	}
+	bigfloat& round() { return (*this).round(bigfloat_precision().limbs, bigfloat_precision().mode); }
+	bigfloat& cut_below(int lowest) {
+		// Drops the digits below D^lowest (used to avoid shifting an operand far below the working precision)
+		if (scale < lowest) (*this).set_scale(lowest);
 		return *this;
 	}
-	bigfloat& operator-=(const bigfloat& f) {
-		if (scale > f.scale) (*this).set_scale(f.scale), (*this).b -= f.b;
-		else (*this).b -= (f.b << (f.scale - scale));
+	int cut_below_sticky(int lowest) {
+		// cut_below(), returning 1 if a nonzero digit was dropped and 0 otherwise
+		int sticky = 0;
+		for (int i = 0; i < std::min(lowest - scale, b.size()) && !sticky; ++i) sticky = (b.nth_digit(i) != 0);
+		(*this).cut_below(lowest);
+		return sticky;
+	}
+	bigfloat& add_exact(const bigfloat& f, bool subtract) {
+		if (scale > f.scale) (*this).set_scale(f.scale);
+		if (scale == f.scale) {
+			if (subtract) b -= f.b;
+			else b += f.b;
+			return *this;
+		}
+		bigint delta = f.b << (f.scale - scale);
+		if (subtract) b -= delta;
+		else b += delta;
 		return *this;
 	}
+	bigfloat& add_rounded(const bigfloat& f, bool subtract) {
+		// *this += f or *this -= f, rounded to the precision. Digits far below it are first cut from the operand with the lower scale,
+		// at D^lowest (two digits under the rounding) or at the scale of the other operand if that is lower. If any of them was nonzero,
+		// the result gets one more digit, 1 above or below the truncated result (a sticky digit), so it rounds like the exact result
+		// in every mode. A subtraction that cancels the leading digits moves the rounding down to the cut, and is redone exactly
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0 && !is_zero() && !f.is_zero()) {
+			int lowest = std::max(top(), f.top()) - preci - 2;
+			int cut = std::min(lowest, std::max(scale, f.scale));
+			if (std::min(scale, f.scale) < cut) {
+				bigfloat saved = (subtract ? *this : bigfloat());
+				int sticky;
+				if (scale < f.scale) sticky = (*this).cut_below_sticky(cut), (*this).add_exact(f, subtract);
+				else {
+					bigfloat g = f;
+					sticky = g.cut_below_sticky(cut) * (subtract ? -1 : 1);
+					(*this).add_exact(g, subtract);
+				}
+				if (sticky == 0) return (*this).round();
+				b <<= 1, --scale;
+				if (sticky > 0) b += bigint(1);
+				else b -= bigint(1);
+				if (top() - preci > cut) return (*this).round();
+				*this = saved;
+			}
+		}
+		return (*this).add_exact(f, subtract).round();
+	}
+	bigfloat& operator+=(const bigfloat& f) { return (*this).add_rounded(f, false); }
+	bigfloat& operator-=(const bigfloat& f) { return (*this).add_rounded(f, true); }
 	bigfloat& operator*=(const bigfloat& f) {
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0 && b.size() + f.b.size() > preci + 1) {
+			// Only the highest preci + 1 digits of the product are computed
+			scale += f.scale + b.size() + f.b.size() - (preci + 1);
+			b = bigint::mul_high(b, f.b, preci + 1);
+			return (*this).round();
+		}
 		b *= f.b;
 		scale += f.scale;
-		return *this;
+		return (*this).round();
 	}
 	bigfloat& operator/=(const bigfloat& f) {
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0) {
+			// Divide with preci + 1 digits of quotient: the divisor only needs preci + 2 digits, and the dividend is shifted to match
+			bigfloat d = f;
+			d.round(preci + 2, rounding::truncate);
+			int k = preci + 1 + d.b.size() - b.size();
+			if (k >= 0) b <<= k;
+			else b >>= -k;
+			b /= d.b;
+			scale -= k + d.scale;
+			return (*this).round();
+		}
 		b /= f.b;
 		scale -= f.scale;
 		return *this;
 	}
+	bigfloat& pow(uint64_t n, int preci) {
+		// The mantissa is truncated to preci digits (in D-ary) after every step; preci = 0 means exact
+		if (n == 0) return (*this) = bigfloat(1);
+		(*this).round(preci, rounding::truncate);
+		bigfloat x = *this;
+		bigint::spectrum sp = x.b.get_spectrum();
+		int bit = 63;
+		while (!(n >> bit & 1)) --bit;
+		for (--bit; bit >= 0; --bit) {
+			b.square();
+			scale *= 2;
+			(*this).round(preci, rounding::truncate);
+			if (n >> bit & 1) {
+				b.multiply(sp);
+				scale += x.scale;
+				(*this).round(preci, rounding::truncate);
+			}
+		}
+		return *this;
+	}
 	bigfloat& divide_by_2() {
+		if (bigfloat_precision().limbs > 0) b <<= 1, --scale; // keep the lowest bit
 		b.divide_by_2();
-		return *this;
+		return (*this).round();
 	}
 	bool operator==(const bigfloat& f) { return b == f.b && scale == f.scale; }
 	bool operator!=(const bigfloat& f) { return b != f.b || scale != f.scale; }
 	bigfloat operator<<(int x) const { return bigfloat(*this) <<= x; }
-	bigfloat operator >> (int x) const { return bigfloat(*this) >>= x; }
+	bigfloat operator>>(int x) const { return bigfloat(*this) >>= x; }
 	bigfloat operator+(const bigfloat& f) const { return bigfloat(*this) += f; }
 	bigfloat operator-(const bigfloat& f) const { return bigfloat(*this) -= f; }
 	bigfloat operator*(const bigfloat& f) const { return bigfloat(*this) *= f; }
 	bigfloat operator/(const bigfloat& f) const { return bigfloat(*this) /= f; }
 	std::string to_string() const {
 		std::string s = b.to_string();
-		if (scale * digit > 0) s += std::string(scale, '0');
-		else if (1 <= -scale * digit && -scale * digit < s.size()) {
+		if (scale * digit > 0) s += std::string(scale * digit, '0');
+		else if(1 <= -scale * digit && -scale * digit < s.size()) {
 			s = s.substr(0, s.size() + scale * digit) + "." + s.substr(s.size() + scale * digit);
 		}
 		else if (-scale * digit >= s.size()) {
@@ -438,4 +1626,15 @@ public:
 	friend std::ostream& operator<<(std::ostream& os, const bigfloat& f) { os << f.to_string(); return os; }
 };
 
+inline bigfloat pow(const bigfloat& x, uint64_t n, int preci) { return bigfloat(x).pow(n, preci); }
+inline bigfloat sqrt(bigfloat x, int final_scale) {
+	// sqrt(x) with final_scale digits (in D-ary) after the point
+	x <<= 2 * final_scale;
+	bigint b = x.to_bigint();
+	b = sqrt(b);
+	bigfloat ans = b;
+	ans >>= final_scale;
+	return ans;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef ___CLASS_FFT
+#define ___CLASS_FFT
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include "instrument.h"
+
+class fft {
+	// Complex Fast Fourier Transform in double precision, for convolutions of small integers (the split digits of bigint).
+	// Results are exact as long as the round-off error stays below 1/2, which is_safe() checks in advance by a proven bound.
+public:
+	using complex = std::complex<double>;
+private:
+	static constexpr int cached_roots = 1 << 16; // tables up to this size (1 MB) stay cached, larger ones only while in use
+	static std::shared_ptr<const std::vector<complex>> twiddles(int s) {
+		// Roots of unity: w[k + j] = exp(i * pi * j / k) for every power of two k < s and j < k.
+		// A table is never changed once built, so a transform keeps using the one it started with. Tables of up to cached_roots
+		// entries are kept for the life of the process; a larger one is only shared by the transforms running at the same time,
+		// and freed after the last of them, so a single large product doesn't leave it resident
+		static std::mutex m;
+		static std::shared_ptr<const std::vector<complex>> cache;
+		static std::weak_ptr<const std::vector<complex>> large;
+		std::lock_guard<std::mutex> lock(m);
+		if (cache != nullptr && int(cache->size()) >= s) return cache;
+		std::shared_ptr<const std::vector<complex>> table = large.lock();
+		if (table != nullptr && int(table->size()) >= s) return table;
+		// Every root is computed in long double from the roots of the level below, and rounded once, so the error of each is within 1 ulp
+		std::vector<complex> w(std::max(s, 2), complex(1));
+		std::vector<std::complex<long double>> prev(1, 1), cur;
+		for (int k = 2; k < s; k *= 2) {
+			std::complex<long double> x = std::polar(1.0L, std::acos(-1.0L) / k);
+			cur.resize(k);
+			for (int j = 0; j < k; ++j) {
+				cur[j] = (j & 1 ? prev[j / 2] * x : prev[j / 2]);
+				w[k + j] = complex(double(cur[j].real()), double(cur[j].imag()));
+			}
+			swap(prev, cur);
+		}
+		BIGINT_ALLOC(w.size() * sizeof(complex));
+		table = std::make_shared<const std::vector<complex>>(std::move(w));
+		if (s <= cached_roots) cache = table;
+		else large = table;
+		return table;
+	}
+public:
+	static double error_bound(int depth, double norm) {
+		// Percival's bound on the error of a convolution through transforms of size 2^depth, where norm = |x|_2 * |y|_2:
+		// norm * ((1 + e)^3d * (1 + e * sqrt(5))^(3d + 1) * (1 + b)^3d - 1), with e = 2^-53 the rounding unit and b = 2^-52 the error of the roots
+		const double e = std::ldexp(1.0, -53), b = std::ldexp(1.0, -52);
+		long double f = std::pow(1.0L + e, 3.0L * depth) * std::pow(1.0L + e * std::sqrt(5.0L), 3.0L * depth + 1) * std::pow(1.0L + b, 3.0L * depth) - 1;
+		return double(norm * f);
+	}
+	static bool is_safe(double norm2, int s) {
+		// Whether a product of two sequences with |x|_2^2 + |y|_2^2 = norm2, through transforms of size s, rounds to the exact result.
+		// convolve() squares z = x + iy and halves the imaginary part, so its error is at most error_bound(|z|_2^2) / 2; a margin of 2 is kept
+		int depth = 0;
+		while ((1 << depth) < s) ++depth;
+		return error_bound(depth, norm2) / 2 < 0.25;
+	}
+	void fourier_transform(std::vector<complex>& v) { fourier_transform(v, *twiddles(v.size())); }
+	void fourier_transform(std::vector<complex>& v, const std::vector<complex>& table) {
+		// In place, forward (the inverse is done by the caller by reversing the input), with a table of twiddles() of at least v.size()
+		int s = v.size();
+		BIGINT_COUNT(instrument::op_fourier_transform);
+		BIGINT_TRANSFORM(s);
+		const complex* w = table.data();
+		for (int i = 0, j = 1; j < s - 1; ++j) {
+			for (int k = s >> 1; k > (i ^= k); k >>= 1);
+			if (i < j) std::swap(v[i], v[j]);
+		}
+		double* p = reinterpret_cast<double*>(v.data());
+		for (int k = 1; k < s; k *= 2) {
+			for (int i = 0; i < s; i += 2 * k) {
+				for (int j = 0; j < k; ++j) {
+					// Multiplication written out: std::complex's operator* also handles infinities and NaN, and is much slower
+					double* x = p + 2 * (i + j);
+					double* y = p + 2 * (i + j + k);
+					double wr = w[j + k].real(), wi = w[j + k].imag();
+					double zr = wr * y[0] - wi * y[1], zi = wr * y[1] + wi * y[0];
+					y[0] = x[0] - zr, y[1] = x[1] - zi;
+					x[0] += zr, x[1] += zi;
+				}
+			}
+		}
+	}
+	std::vector<long long> convolve(const std::vector<int>& v1, const std::vector<int>& v2) {
+		// Exact if is_safe(|v1|_2^2 + |v2|_2^2, s) for the transform size s >= v1.size() + v2.size() - 1.
+		// v1 and v2 are packed into one complex sequence z = v1 + i * v2, whose square has 2 * v1 * v2 as its imaginary part
+		BIGINT_COUNT(instrument::op_convolve);
+		int n = v1.size() + v2.size() - 1, s = 1;
+		while (s < n) s <<= 1;
+		// The roots first: their construction needs more memory than the table itself, which is then not taken with z and out
+		std::shared_ptr<const std::vector<complex>> table = twiddles(s);
+		std::vector<complex> z(s), out(s);
+		BIGINT_ALLOC(2 * s * sizeof(complex));
+		for (int i = 0; i < v1.size(); ++i) z[i].real(v1[i]);
+		for (int i = 0; i < v2.size(); ++i) z[i].imag(v2[i]);
+		{
+			BIGINT_PHASE(instrument::phase_forward);
+			fourier_transform(z, *table);
+		}
+		{
+			// The inverse transform of Z^2 is a forward transform of the conjugates in reverse order; subtracting
+			// conj(Z^2) there leaves only the imaginary part (2 * v1 * v2) of the result
+			BIGINT_PHASE(instrument::phase_pointwise);
+			for (complex& x : z) {
+				double r = x.real(), i = x.imag();
+				x = complex(r * r - i * i, 2 * r * i);
+			}
+			for (int i = 0; i < s; ++i) out[i] = z[-i & (s - 1)] - std::conj(z[i]);
+		}
+		{
+			BIGINT_PHASE(instrument::phase_inverse);
+			fourier_transform(out, *table);
+		}
+		std::vector<long long> ans(n);
+		for (int i = 0; i < n; ++i) ans[i] = std::llround(out[i].imag() / (4.0 * s));
+		return ans;
+	}
+};
+
+inline fft fft_base;
+
+#endif
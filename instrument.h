@@ -0,0 +1,154 @@
+#ifndef ___CLASS_INSTRUMENT
+#define ___CLASS_INSTRUMENT
+
+// Opt-in instrumentation of the hot paths: compile with -DBIGINT_INSTRUMENT to enable it.
+// Without it, the BIGINT_COUNT / BIGINT_TRANSFORM / BIGINT_PHASE / BIGINT_ALLOC / BIGINT_PLAN macros expand to nothing.
+//   instrument_snapshot s = instrument::snapshot(); // consistent per counter, callable from any thread
+//   std::cout << s.to_text() << s.to_json();
+//   instrument::reset();
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace instrument {
+	enum operation { op_convolve, op_fourier_transform, op_multiply, op_square, op_mul_high, op_divide, op_parse, op_print, op_count };
+	enum phase { phase_forward, phase_pointwise, phase_inverse, phase_crt, phase_count };
+	const int histogram_size = 32; // bucket i counts transforms of size 2^i
+	const int plan_methods = 3; // the methods of multiply_plan, in its order
+	inline const char* operation_name(int i) {
+		static const char* names[op_count] = { "convolve", "fourier_transform", "multiply", "square", "mul_high", "divide", "parse", "print" };
+		return names[i];
+	}
+	inline const char* phase_name(int i) {
+		static const char* names[phase_count] = { "forward", "pointwise", "inverse", "crt" };
+		return names[i];
+	}
+	inline const char* plan_name(int i) {
+		static const char* names[plan_methods] = { "standard", "in_place", "block" };
+		return names[i];
+	}
+
+	struct counters {
+		std::atomic<uint64_t> calls[op_count];
+		std::atomic<uint64_t> transform_sizes[histogram_size];
+		std::atomic<uint64_t> phase_nanoseconds[phase_count];
+		std::atomic<uint64_t> bytes_allocated;
+		std::atomic<uint64_t> plans[plan_methods]; // products planned under tuning().memory_budget_mb, by method
+		std::atomic<uint64_t> plans_over_budget;
+		std::atomic<uint64_t> max_planned_peak; // largest estimated peak of those plans, in bytes
+	};
+	inline counters& global() {
+		static counters c = {};
+		return c;
+	}
+}
+
+struct instrument_snapshot {
+	uint64_t calls[instrument::op_count];
+	uint64_t transform_sizes[instrument::histogram_size];
+	uint64_t phase_nanoseconds[instrument::phase_count];
+	uint64_t bytes_allocated;
+	uint64_t plans[instrument::plan_methods];
+	uint64_t plans_over_budget;
+	uint64_t max_planned_peak;
+	std::string to_text() const {
+		std::string s;
+		for (int i = 0; i < instrument::op_count; ++i) s += std::string(instrument::operation_name(i)) + ": " + std::to_string(calls[i]) + " calls\n";
+		for (int i = 0; i < instrument::histogram_size; ++i) {
+			if (transform_sizes[i] != 0) s += "transform size 2^" + std::to_string(i) + ": " + std::to_string(transform_sizes[i]) + "\n";
+		}
+		for (int i = 0; i < instrument::phase_count; ++i) s += std::string(instrument::phase_name(i)) + ": " + std::to_string(phase_nanoseconds[i] / 1000000.0) + " ms\n";
+		s += "allocated: " + std::to_string(bytes_allocated) + " bytes\n";
+		for (int i = 0; i < instrument::plan_methods; ++i) s += std::string("plan ") + instrument::plan_name(i) + ": " + std::to_string(plans[i]) + "\n";
+		s += "plans over budget: " + std::to_string(plans_over_budget) + "\n";
+		s += "largest planned peak: " + std::to_string(max_planned_peak) + " bytes\n";
+		return s;
+	}
+	std::string to_json() const {
+		std::string s = "{\"calls\": {";
+		for (int i = 0; i < instrument::op_count; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::operation_name(i) + "\": " + std::to_string(calls[i]);
+		s += "}, \"transform_sizes\": {";
+		bool first = true;
+		for (int i = 0; i < instrument::histogram_size; ++i) {
+			if (transform_sizes[i] == 0) continue;
+			s += std::string(first ? "" : ", ") + "\"" + std::to_string(1ull << i) + "\": " + std::to_string(transform_sizes[i]);
+			first = false;
+		}
+		s += "}, \"phase_nanoseconds\": {";
+		for (int i = 0; i < instrument::phase_count; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::phase_name(i) + "\": " + std::to_string(phase_nanoseconds[i]);
+		s += "}, \"bytes_allocated\": " + std::to_string(bytes_allocated) + ", \"plans\": {";
+		for (int i = 0; i < instrument::plan_methods; ++i) s += std::string(i ? ", " : "") + "\"" + instrument::plan_name(i) + "\": " + std::to_string(plans[i]);
+		s += "}, \"plans_over_budget\": " + std::to_string(plans_over_budget) + ", \"max_planned_peak\": " + std::to_string(max_planned_peak) + "}";
+		return s;
+	}
+};
+
+namespace instrument {
+	inline instrument_snapshot snapshot() {
+		counters& c = global();
+		instrument_snapshot s;
+		for (int i = 0; i < op_count; ++i) s.calls[i] = c.calls[i].load(std::memory_order_relaxed);
+		for (int i = 0; i < histogram_size; ++i) s.transform_sizes[i] = c.transform_sizes[i].load(std::memory_order_relaxed);
+		for (int i = 0; i < phase_count; ++i) s.phase_nanoseconds[i] = c.phase_nanoseconds[i].load(std::memory_order_relaxed);
+		s.bytes_allocated = c.bytes_allocated.load(std::memory_order_relaxed);
+		for (int i = 0; i < plan_methods; ++i) s.plans[i] = c.plans[i].load(std::memory_order_relaxed);
+		s.plans_over_budget = c.plans_over_budget.load(std::memory_order_relaxed);
+		s.max_planned_peak = c.max_planned_peak.load(std::memory_order_relaxed);
+		return s;
+	}
+	inline void reset() {
+		counters& c = global();
+		for (int i = 0; i < op_count; ++i) c.calls[i] = 0;
+		for (int i = 0; i < histogram_size; ++i) c.transform_sizes[i] = 0;
+		for (int i = 0; i < phase_count; ++i) c.phase_nanoseconds[i] = 0;
+		c.bytes_allocated = 0;
+		for (int i = 0; i < plan_methods; ++i) c.plans[i] = 0;
+		c.plans_over_budget = 0;
+		c.max_planned_peak = 0;
+	}
+	inline void count(operation op) { global().calls[op].fetch_add(1, std::memory_order_relaxed); }
+	inline void transform(uint64_t size) {
+		int lg = 0;
+		while ((2ull << lg) <= size) ++lg;
+		global().transform_sizes[lg].fetch_add(1, std::memory_order_relaxed);
+	}
+	inline void alloc(uint64_t bytes) { global().bytes_allocated.fetch_add(bytes, std::memory_order_relaxed); }
+	inline void plan(int method, uint64_t peak_bytes, bool fits) {
+		counters& c = global();
+		c.plans[method].fetch_add(1, std::memory_order_relaxed);
+		if (!fits) c.plans_over_budget.fetch_add(1, std::memory_order_relaxed);
+		uint64_t m = c.max_planned_peak.load(std::memory_order_relaxed);
+		while (m < peak_bytes && !c.max_planned_peak.compare_exchange_weak(m, peak_bytes, std::memory_order_relaxed));
+	}
+	class phase_timer {
+	private:
+		phase p;
+		std::chrono::steady_clock::time_point start;
+	public:
+		phase_timer(phase p_) : p(p_), start(std::chrono::steady_clock::now()) {};
+		~phase_timer() {
+			uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			global().phase_nanoseconds[p].fetch_add(ns, std::memory_order_relaxed);
+		}
+	};
+}
+
+#define BIGINT_CONCAT_INNER(a, b) a##b
+#define BIGINT_CONCAT(a, b) BIGINT_CONCAT_INNER(a, b)
+#ifdef BIGINT_INSTRUMENT
+#define BIGINT_COUNT(op) instrument::count(op)
+#define BIGINT_TRANSFORM(size) instrument::transform(size)
+#define BIGINT_PHASE(p) instrument::phase_timer BIGINT_CONCAT(bigint_phase_timer_, __LINE__)(p)
+#define BIGINT_ALLOC(bytes) instrument::alloc(bytes)
+#define BIGINT_PLAN(method, peak_bytes, fits) instrument::plan(method, peak_bytes, fits)
+#else
+#define BIGINT_COUNT(op) ((void)0)
+#define BIGINT_TRANSFORM(size) ((void)0)
+#define BIGINT_PHASE(p) ((void)0)
+#define BIGINT_ALLOC(bytes) ((void)0)
+#define BIGINT_PLAN(method, peak_bytes, fits) ((void)0)
+#endif
+
+#endif
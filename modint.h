@@ -3,11 +3,12 @@
 
 #include <vector>
 #include <cstdint>
+#include "instrument.h"
 
 using singlebit = uint32_t;
 using doublebit = uint64_t;
 
-static constexpr singlebit find_inv(singlebit n, int d = 5, singlebit x = 1) {
+constexpr singlebit find_inv(singlebit n, int d = 5, singlebit x = 1) {
 	return d == 0 ? x : find_inv(n, d - 1, x * (2 - x * n));
 }
 template <singlebit mod, singlebit primroot> class modint {
@@ -18,26 +19,34 @@ private:
 	static constexpr singlebit max_value = -1;
 	static constexpr singlebit r2 = (((1ull << level) % mod) << level) % mod;
 	static constexpr singlebit inv = singlebit(-1) * find_inv(mod);
-	static singlebit reduce(doublebit x) {
+	static constexpr singlebit reduce(doublebit x) {
 		singlebit res = (x + doublebit(singlebit(x) * inv) * mod) >> level;
 		return res < mod ? res : res - mod;
 	}
 public:
-	modint() : n(0) {};
-	modint(singlebit n_) { n = reduce(doublebit(n_) * r2); };
-	modint& operator=(const singlebit x) { n = reduce(doublebit(x) * r2); return *this; }
-	bool operator==(const modint& x) const { return n == x.n; }
-	bool operator!=(const modint& x) const { return n != x.n; }
-	modint& operator+=(const modint& x) { n += x.n; n -= (n < mod ? 0 : mod); return *this; }
-	modint& operator-=(const modint& x) { n += mod - x.n; n -= (n < mod ? 0 : mod); return *this; }
-	modint& operator*=(const modint& x) { n = reduce(1ull * n * x.n); return *this; }
-	modint operator+(const modint& x) const { return modint(*this) += x; }
-	modint operator-(const modint& x) const { return modint(*this) -= x; }
-	modint operator*(const modint& x) const { return modint(*this) *= x; }
-	static singlebit get_mod() { return mod; }
-	static singlebit get_primroot() { return primroot; }
-	singlebit get() { return reduce(doublebit(n)); }
-	modint binpow(singlebit b) {
+	constexpr modint() : n(0) {};
+	constexpr modint(singlebit n_) : n(reduce(doublebit(n_) * r2)) {};
+	constexpr modint& operator=(const singlebit x) { n = reduce(doublebit(x) * r2); return *this; }
+	constexpr bool operator==(const modint& x) const { return n == x.n; }
+	constexpr bool operator!=(const modint& x) const { return n != x.n; }
+	constexpr modint& operator+=(const modint& x) { n += x.n; n -= (n < mod ? 0 : mod); return *this; }
+	constexpr modint& operator-=(const modint& x) { n += mod - x.n; n -= (n < mod ? 0 : mod); return *this; }
+	constexpr modint& operator*=(const modint& x) { n = reduce(1ull * n * x.n); return *this; }
+	constexpr modint operator+(const modint& x) const { return modint(*this) += x; }
+	constexpr modint operator-(const modint& x) const { return modint(*this) -= x; }
+	constexpr modint operator*(const modint& x) const { return modint(*this) *= x; }
+	static constexpr singlebit get_mod() { return mod; }
+	static constexpr singlebit get_primroot() { return primroot; }
+	constexpr singlebit get() const { return reduce(doublebit(n)); }
+	// Raw Montgomery residues, for kernels that keep them lazily in [0, 2 * mod) between steps (the transforms of ntt.h)
+	constexpr singlebit raw() const { return n; }
+	static constexpr modint from_raw(singlebit x) { modint r; r.n = x; return r; }
+	static constexpr singlebit mul_lazy(singlebit x, singlebit y) {
+		// Montgomery product without the final subtraction: in [0, 2 * mod) if x * y < mod * 2^32 (e.g. x < 4 * mod, y < mod)
+		doublebit z = doublebit(x) * y;
+		return (z + doublebit(singlebit(z) * inv) * mod) >> level;
+	}
+	constexpr modint binpow(singlebit b) const {
 		modint ans(1), cur(*this);
 		while (b > 0) {
 			if (b & 1) ans *= cur;
@@ -49,8 +58,9 @@ public:
 };
 
 template<typename modulo>
-std::vector<modulo> get_modvector(std::vector<int> v) {
+std::vector<modulo> get_modvector(const std::vector<int>& v) {
 	std::vector<modulo> ans(v.size());
+	BIGINT_ALLOC(ans.size() * sizeof(modulo));
 	for (int i = 0; i < v.size(); ++i) {
 		ans[i] = v[i];
 	}
@@ -3,6 +3,27 @@
 
 #include "newbigint.h"
 
+enum class rounding { truncate, nearest, up };
+
+struct precision_context {
+	int limbs; // digits (in D-ary) kept in the mantissa after every operation; 0 means exact
+	rounding mode;
+};
+inline precision_context& bigfloat_precision() {
+	thread_local precision_context context = { 0, rounding::nearest };
+	return context;
+}
+class precision_guard {
+	// Sets the precision of the current thread, until the guard goes out of scope
+private:
+	precision_context saved;
+public:
+	precision_guard(int limbs, rounding mode = rounding::nearest) : saved(bigfloat_precision()) { bigfloat_precision() = precision_context{ limbs, mode }; }
+	~precision_guard() { bigfloat_precision() = saved; }
+	precision_guard(const precision_guard&) = delete;
+	precision_guard& operator=(const precision_guard&) = delete;
+};
+
 class bigfloat {
 private:
 	bigint b;
@@ -21,32 +42,133 @@ public:
 	}
 	bigfloat& operator<<=(int x) { scale += x; return *this; }
 	bigfloat& operator>>=(int x) { scale -= x; return *this; }
-	bigfloat& operator+=(const bigfloat& f) {
-		if (scale > f.scale) (*this).set_scale(f.scale), (*this).b += f.b;
-		else {
-			bigint delta = f.b << (f.scale - scale);
-			(*this).b += delta;
+	bool is_zero() const { return b.size() == 1 && b.nth_digit(0) == 0; }
+	int top() const { return scale + b.size(); } // the value is less than D^top()
+	bigfloat& round(int preci, rounding mode) {
+		// Keeps the highest preci digits (in D-ary) of the mantissa, rounding the rest away
+		if (preci <= 0 || b.size() <= preci) return *this;
+		int drop = b.size() - preci;
+		bool carry = false;
+		if (mode == rounding::nearest) carry = (b.nth_digit(drop - 1) >= digit_base / 2);
+		if (mode == rounding::up) {
+			for (int i = 0; i < drop && !carry; ++i) carry = (b.nth_digit(i) != 0);
 		}
+		b >>= drop;
+		scale += drop;
+		if (carry) {
+			b += bigint(1);
+			if (b.size() > preci) b >>= 1, ++scale; // 99...9 + 1 = 100...0, dropping a zero digit is exact
+		}
+		return *this;
+	}
+	bigfloat& round() { return (*this).round(bigfloat_precision().limbs, bigfloat_precision().mode); }
+	bigfloat& cut_below(int lowest) {
+		// Drops the digits below D^lowest (used to avoid shifting an operand far below the working precision)
+		if (scale < lowest) (*this).set_scale(lowest);
 		return *this;
 	}
-	bigfloat& operator-=(const bigfloat& f) {
-		if (scale > f.scale) (*this).set_scale(f.scale), (*this).b -= f.b;
-		else (*this).b -= (f.b << (f.scale - scale));
+	int cut_below_sticky(int lowest) {
+		// cut_below(), returning 1 if a nonzero digit was dropped and 0 otherwise
+		int sticky = 0;
+		for (int i = 0; i < std::min(lowest - scale, b.size()) && !sticky; ++i) sticky = (b.nth_digit(i) != 0);
+		(*this).cut_below(lowest);
+		return sticky;
+	}
+	bigfloat& add_exact(const bigfloat& f, bool subtract) {
+		if (scale > f.scale) (*this).set_scale(f.scale);
+		if (scale == f.scale) {
+			if (subtract) b -= f.b;
+			else b += f.b;
+			return *this;
+		}
+		bigint delta = f.b << (f.scale - scale);
+		if (subtract) b -= delta;
+		else b += delta;
 		return *this;
 	}
+	bigfloat& add_rounded(const bigfloat& f, bool subtract) {
+		// *this += f or *this -= f, rounded to the precision. Digits far below it are first cut from the operand with the lower scale,
+		// at D^lowest (two digits under the rounding) or at the scale of the other operand if that is lower. If any of them was nonzero,
+		// the result gets one more digit, 1 above or below the truncated result (a sticky digit), so it rounds like the exact result
+		// in every mode. A subtraction that cancels the leading digits moves the rounding down to the cut, and is redone exactly
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0 && !is_zero() && !f.is_zero()) {
+			int lowest = std::max(top(), f.top()) - preci - 2;
+			int cut = std::min(lowest, std::max(scale, f.scale));
+			if (std::min(scale, f.scale) < cut) {
+				bigfloat saved = (subtract ? *this : bigfloat());
+				int sticky;
+				if (scale < f.scale) sticky = (*this).cut_below_sticky(cut), (*this).add_exact(f, subtract);
+				else {
+					bigfloat g = f;
+					sticky = g.cut_below_sticky(cut) * (subtract ? -1 : 1);
+					(*this).add_exact(g, subtract);
+				}
+				if (sticky == 0) return (*this).round();
+				b <<= 1, --scale;
+				if (sticky > 0) b += bigint(1);
+				else b -= bigint(1);
+				if (top() - preci > cut) return (*this).round();
+				*this = saved;
+			}
+		}
+		return (*this).add_exact(f, subtract).round();
+	}
+	bigfloat& operator+=(const bigfloat& f) { return (*this).add_rounded(f, false); }
+	bigfloat& operator-=(const bigfloat& f) { return (*this).add_rounded(f, true); }
 	bigfloat& operator*=(const bigfloat& f) {
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0 && b.size() + f.b.size() > preci + 1) {
+			// Only the highest preci + 1 digits of the product are computed
+			scale += f.scale + b.size() + f.b.size() - (preci + 1);
+			b = bigint::mul_high(b, f.b, preci + 1);
+			return (*this).round();
+		}
 		b *= f.b;
 		scale += f.scale;
-		return *this;
+		return (*this).round();
 	}
 	bigfloat& operator/=(const bigfloat& f) {
+		int preci = bigfloat_precision().limbs;
+		if (preci > 0) {
+			// Divide with preci + 1 digits of quotient: the divisor only needs preci + 2 digits, and the dividend is shifted to match
+			bigfloat d = f;
+			d.round(preci + 2, rounding::truncate);
+			int k = preci + 1 + d.b.size() - b.size();
+			if (k >= 0) b <<= k;
+			else b >>= -k;
+			b /= d.b;
+			scale -= k + d.scale;
+			return (*this).round();
+		}
 		b /= f.b;
 		scale -= f.scale;
 		return *this;
 	}
+	bigfloat& pow(uint64_t n, int preci) {
+		// The mantissa is truncated to preci digits (in D-ary) after every step; preci = 0 means exact
+		if (n == 0) return (*this) = bigfloat(1);
+		(*this).round(preci, rounding::truncate);
+		bigfloat x = *this;
+		bigint::spectrum sp = x.b.get_spectrum();
+		int bit = 63;
+		while (!(n >> bit & 1)) --bit;
+		for (--bit; bit >= 0; --bit) {
+			b.square();
+			scale *= 2;
+			(*this).round(preci, rounding::truncate);
+			if (n >> bit & 1) {
+				b.multiply(sp);
+				scale += x.scale;
+				(*this).round(preci, rounding::truncate);
+			}
+		}
+		return *this;
+	}
 	bigfloat& divide_by_2() {
+		if (bigfloat_precision().limbs > 0) b <<= 1, --scale; // keep the lowest bit
 		b.divide_by_2();
-		return *this;
+		return (*this).round();
 	}
 	bool operator==(const bigfloat& f) { return b == f.b && scale == f.scale; }
 	bool operator!=(const bigfloat& f) { return b != f.b || scale != f.scale; }
@@ -58,7 +180,7 @@ public:
 	bigfloat operator/(const bigfloat& f) const { return bigfloat(*this) /= f; }
 	std::string to_string() const {
 		std::string s = b.to_string();
-		if (scale * digit > 0) s += std::string(scale, '0');
+		if (scale * digit > 0) s += std::string(scale * digit, '0');
 		else if(1 <= -scale * digit && -scale * digit < s.size()) {
 			s = s.substr(0, s.size() + scale * digit) + "." + s.substr(s.size() + scale * digit);
 		}
@@ -74,4 +196,15 @@ public:
 	friend std::ostream& operator<<(std::ostream& os, const bigfloat& f) { os << f.to_string(); return os; }
 };
 
+inline bigfloat pow(const bigfloat& x, uint64_t n, int preci) { return bigfloat(x).pow(n, preci); }
+inline bigfloat sqrt(bigfloat x, int final_scale) {
+	// sqrt(x) with final_scale digits (in D-ary) after the point
+	x <<= 2 * final_scale;
+	bigint b = x.to_bigint();
+	b = sqrt(b);
+	bigfloat ans = b;
+	ans >>= final_scale;
+	return ans;
+}
+
 #endif
\ No newline at end of file
@@ -12,6 +12,7 @@ const int digit_base = 10000;
 class bigint : public basic_integer<digit_base> {
 public:
 	bigint() { a = std::vector<int>({ 0 }); };
+	bigint(const basic_integer& x) : basic_integer(x) {};
 	bigint(long long x) {
 		a.clear();
 		for (int i = 0; x > 0; ++i) {
@@ -21,6 +22,7 @@ public:
 		if (a.size() == 0) a = { 0 };
 	}
 	bigint(const std::string& s) {
+		BIGINT_COUNT(instrument::op_parse);
 		a.clear();
 		for (int i = 0; digit * i < s.size(); ++i) {
 			a.push_back(std::stoi(s.substr(std::max(int(s.size()) - i * digit - digit, 0), digit - std::max(digit + i * digit - int(s.size()), 0))));
@@ -28,6 +30,7 @@ public:
 		if (a.size() == 0) a = { 0 };
 	}
 	std::string to_string() const {
+		BIGINT_COUNT(instrument::op_print);
 		std::string ret;
 		bool flag = false;
 		for (int i = a.size() - 1; i >= 0; --i) {
@@ -48,8 +51,13 @@ public:
 	bigint& operator>>=(int x) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) >>= x); }
 	bigint& operator+=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) += basic_integer(b)); }
 	bigint& operator-=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) -= basic_integer(b)); }
-	bigint& operator*=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) *= basic_integer(b)); }
+	bigint& operator*=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) *= reinterpret_cast<const basic_integer&>(b.a)); }
 	bigint& operator/=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) /= basic_integer(b)); }
+	bigint& operator%=(const bigint& b) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a) %= basic_integer(b)); }
+	bigint& multiply(const spectrum& sp) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).multiply(sp)); }
+	bigint& multiply(const bigint& b, const multiply_plan& plan) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).multiply(b, plan)); }
+	bigint& square() { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).square()); }
+	bigint& pow(uint64_t n) { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).pow(n)); }
 	bigint& divide_by_2() { return reinterpret_cast<bigint&>(reinterpret_cast<basic_integer&>(a).divide_by_2()); }
 	bigint operator<<(int x) const { return bigint(*this) <<= x; }
 	bigint operator>>(int x) const { return bigint(*this) >>= x; }
@@ -57,8 +65,37 @@ public:
 	bigint operator-(const bigint& b) const { return bigint(*this) -= b; }
 	bigint operator*(const bigint& b) const { return bigint(*this) *= b; }
 	bigint operator/(const bigint& b) const { return bigint(*this) /= b; }
+	bigint operator%(const bigint& b) const { return bigint(*this) %= b; }
 	friend std::istream& operator>>(std::istream& is, bigint& x) { std::string s; is >> s; x = bigint(s); return is; }
 	friend std::ostream& operator<<(std::ostream& os, const bigint& x) { os << x.to_string(); return os; }
 };
 
+inline bigint pow(const bigint& x, uint64_t n) { return bigint(x).pow(n); }
+inline bigint sqrt(const bigint& x) {
+	// floor(sqrt(x)) by Newton's method on the highest 2 * scale digits of x, doubling scale each step. At the first and the last
+	// scale the steps run until they stop decreasing: one step from any a > 0 gives at least floor(sqrt), and from there the steps
+	// decrease down to it. Stopping only when a step repeats could alternate between two values forever (99 and 100 for 9999)
+	if (x == bigint(0)) return x;
+	int max_scale = (x.size() + 1) / 2;
+	int scale = std::min(4, max_scale);
+	auto step = [&](const bigint& a) {
+		bigint xd = x;
+		if (x.size() > 2 * scale) xd >>= (x.size() - 2 * scale + x.size() % 2);
+		return (a + xd / a).divide_by_2();
+	};
+	auto descend = [&](bigint a) {
+		a = step(a);
+		for (bigint next = step(a); next < a; next = step(a)) a = next;
+		return a;
+	};
+	bigint a = descend(bigint(1) << (scale - 1));
+	while (scale < max_scale) {
+		a = step(a);
+		int next_scale = std::min(max_scale, scale * 2);
+		a <<= next_scale - scale;
+		scale = next_scale;
+	}
+	return descend(a);
+}
+
 #endif
\ No newline at end of file
@@ -2,77 +2,269 @@
 #define ___CLASS_NTT
 
 #include <vector>
+#include <array>
+#include <algorithm>
 #include "modint.h"
+#include "tuning.h"
+
+template<typename modulo>
+constexpr int ntt_depth() {
+	// The largest d such that 2^d divides mod - 1, so that the transform size is up to 2^d
+	int depth = 0;
+	for (uint32_t div_number = modulo::get_mod() - 1; div_number % 2 == 0; div_number >>= 1) ++depth;
+	return depth;
+}
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_roots(bool inverse) {
+	// roots[i] is a primitive 2^i-th root of unity (or its inverse)
+	constexpr int depth = ntt_depth<modulo>();
+	std::array<modulo, 32> roots = {};
+	roots[depth] = modulo(modulo::get_primroot()).binpow((modulo::get_mod() - 1) >> depth);
+	if (inverse) roots[depth] = roots[depth].binpow(modulo::get_mod() - 2);
+	for (int i = depth - 1; i >= 0; --i) roots[i] = roots[i + 1] * roots[i + 1];
+	return roots;
+}
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_powinv() {
+	// powinv[i] = 1 / 2^i
+	std::array<modulo, 32> powinv = {};
+	powinv[0] = 1;
+	for (int i = 1; i < 32; ++i) powinv[i] = powinv[i - 1] * modulo((modulo::get_mod() + 1) / 2);
+	return powinv;
+}
+
+template<typename modulo>
+constexpr std::array<modulo, 32> ntt_rates(int radix_log, bool inverse) {
+	// Twiddle steps of the radix-2 (radix_log = 1) and radix-4 (radix_log = 2) passes, which visit the blocks of a level in
+	// bit-reversed order: going from block s to block s + 1, where s ends with exactly i one bits, multiplies the twiddle by rates[i]
+	std::array<modulo, 32> roots = ntt_roots<modulo>(inverse), iroots = ntt_roots<modulo>(!inverse), rates = {};
+	modulo prod(1);
+	for (int i = 0; i + radix_log + 1 <= ntt_depth<modulo>(); ++i) {
+		rates[i] = roots[i + radix_log + 1] * prod;
+		prod *= iroots[i + radix_log + 1];
+	}
+	return rates;
+}
 
 template<typename modulo>
 class ntt {
 	// Number Theoretic Transform
+	// All tables are computed at compile time and the engine has no state, so one instance can be shared by every thread
 private:
-	int depth;
-	std::vector<modulo> roots;
-	std::vector<modulo> powinv;
+	static constexpr int depth = ntt_depth<modulo>();
+	static constexpr std::array<modulo, 32> roots = ntt_roots<modulo>(false);
+	static constexpr std::array<modulo, 32> iroots = ntt_roots<modulo>(true);
+	static constexpr std::array<modulo, 32> powinv = ntt_powinv<modulo>();
+	static constexpr std::array<modulo, 32> rate2 = ntt_rates<modulo>(1, false);
+	static constexpr std::array<modulo, 32> rate3 = ntt_rates<modulo>(2, false);
+	static constexpr std::array<modulo, 32> irate3 = ntt_rates<modulo>(2, true);
+	// The passes work on the raw Montgomery residues and keep them in [0, 2 * mod) (Harvey's lazy reduction): a butterfly adds
+	// two of them and reduces the sum once, below 4 * mod, so no sum of the transforms overflows 32 bits
+	static_assert(modulo::get_mod() < (1u << 30), "lazy reduction needs 4 * mod < 2^32");
+	static_assert(sizeof(modulo) == sizeof(singlebit), "the transforms work on the raw residues of a modulo array");
+	static constexpr singlebit mod = modulo::get_mod(), mod2 = 2 * modulo::get_mod();
+	static singlebit reduce2(singlebit x) { return x - (x >= mod2 ? mod2 : 0); } // [0, 4 * mod) to [0, 2 * mod)
+	static int trailing_ones(int s) {
+		int k = 0;
+		while (s >> k & 1) ++k;
+		return k;
+	}
+	static void forward_dif(singlebit* v, int h) {
+		// Decimation in frequency on 2^h elements, two levels per pass (radix 4) and one radix-2 pass at the end if h is odd.
+		// The input is in natural order and the output in bit-reversed order, so no permutation is needed
+		int len = 0;
+		while (len < h) {
+			if (h - len == 1) {
+				int p = 1 << (h - len - 1);
+				modulo rot(1);
+				for (int s = 0; s < (1 << len); ++s) {
+					singlebit* x = v + (s << (h - len));
+					singlebit w = rot.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit l = x[i], r = modulo::mul_lazy(x[i + p], w);
+						x[i] = reduce2(l + r);
+						x[i + p] = reduce2(l + mod2 - r);
+					}
+					if (s + 1 != (1 << len)) rot *= rate2[trailing_ones(s)];
+				}
+				len += 1;
+			}
+			else {
+				int p = 1 << (h - len - 2);
+				modulo rot(1);
+				const singlebit imag = roots[2].raw();
+				for (int s = 0; s < (1 << len); ++s) {
+					singlebit* x = v + (s << (h - len));
+					modulo rot2 = rot * rot, rot3 = rot2 * rot;
+					singlebit w1 = rot.raw(), w2 = rot2.raw(), w3 = rot3.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit a0 = x[i];
+						singlebit a1 = modulo::mul_lazy(x[i + p], w1);
+						singlebit a2 = modulo::mul_lazy(x[i + 2 * p], w2);
+						singlebit a3 = modulo::mul_lazy(x[i + 3 * p], w3);
+						singlebit b0 = reduce2(a0 + a2), b1 = reduce2(a0 + mod2 - a2);
+						singlebit c0 = reduce2(a1 + a3), c1 = modulo::mul_lazy(a1 + mod2 - a3, imag);
+						x[i] = reduce2(b0 + c0);
+						x[i + p] = reduce2(b0 + mod2 - c0);
+						x[i + 2 * p] = reduce2(b1 + c1);
+						x[i + 3 * p] = reduce2(b1 + mod2 - c1);
+					}
+					if (s + 1 != (1 << len)) rot *= rate3[trailing_ones(s)];
+				}
+				len += 2;
+			}
+		}
+	}
+	static void inverse_dit(singlebit* v, int h) {
+		// Decimation in time, radix 4 from the smallest blocks up: bit-reversed order in, natural order out. If h is odd, the last
+		// pass is a radix-2 one over the whole array, a single block whose twiddle is 1
+		int len = h;
+		while (len > 0) {
+			if (len == 1) {
+				int p = 1 << (h - 1);
+				singlebit* x = v;
+				for (int i = 0; i < p; ++i) {
+					singlebit l = x[i], r = x[i + p];
+					x[i] = reduce2(l + r);
+					x[i + p] = reduce2(l + mod2 - r);
+				}
+				len -= 1;
+			}
+			else {
+				int p = 1 << (h - len);
+				modulo irot(1);
+				const singlebit iimag = iroots[2].raw();
+				for (int s = 0; s < (1 << (len - 2)); ++s) {
+					singlebit* x = v + (s << (h - len + 2));
+					modulo irot2 = irot * irot, irot3 = irot2 * irot;
+					singlebit w1 = irot.raw(), w2 = irot2.raw(), w3 = irot3.raw();
+					for (int i = 0; i < p; ++i) {
+						singlebit a0 = x[i], a1 = x[i + p], a2 = x[i + 2 * p], a3 = x[i + 3 * p];
+						singlebit b0 = reduce2(a0 + a1), b1 = reduce2(a0 + mod2 - a1);
+						singlebit c0 = reduce2(a2 + a3), c1 = modulo::mul_lazy(a2 + mod2 - a3, iimag);
+						x[i] = reduce2(b0 + c0);
+						x[i + p] = modulo::mul_lazy(b1 + c1, w1);
+						x[i + 2 * p] = modulo::mul_lazy(b0 + mod2 - c0, w2);
+						x[i + 3 * p] = modulo::mul_lazy(b1 + mod2 - c1, w3);
+					}
+					if (s + 1 != (1 << (len - 2))) irot *= irate3[trailing_ones(s)];
+				}
+				len -= 2;
+			}
+		}
+	}
 public:
-	ntt() {
-		depth = 0;
-		uint32_t div_number = modulo::get_mod() - 1;
-		while (div_number % 2 == 0) div_number >>= 1, ++depth;
-		modulo b = modulo::get_primroot();
-		for (int i = 0; i < depth; ++i) b *= b;
-		modulo baseroot = modulo::get_primroot(), bb = b;
-		while (bb != 1) bb *= b, baseroot *= modulo::get_primroot();
-		roots = std::vector<modulo>(depth + 1, 0);
-		powinv = std::vector<modulo>(depth + 1, 0);
-		powinv[1] = (modulo::get_mod() + 1) / 2;
-		for (int i = 2; i <= depth; ++i) powinv[i] = powinv[i - 1] * powinv[1];
-		roots[depth] = 1;
-		for (int i = 0; i < modulo::get_mod() - 1; i += 1 << depth) roots[depth] *= baseroot;
-		for (int i = depth - 1; i >= 1; --i) roots[i] = roots[i + 1] * roots[i + 1];
+	void transform(modulo* v, int s, bool inverse) {
+		// In place on a caller buffer of s elements (a power of two, up to 2^depth). The forward transform leaves the spectrum in
+		// bit-reversed order, which the inverse takes back, so spectra are only meant to be multiplied pointwise with spectra of the
+		// same size. The inverse includes the division by s, so transform(v, s, true) undoes transform(v, s, false)
+		BIGINT_COUNT(instrument::op_fourier_transform);
+		BIGINT_TRANSFORM(s);
+		BIGINT_PHASE(inverse ? instrument::phase_inverse : instrument::phase_forward);
+		int h = 0;
+		while ((1 << h) < s) ++h;
+		singlebit* x = reinterpret_cast<singlebit*>(v);
+		if (!inverse) {
+			forward_dif(x, h);
+			for (int i = 0; i < s; ++i) x[i] -= (x[i] >= mod ? mod : 0);
+		}
+		else {
+			inverse_dit(x, h);
+			const singlebit f = powinv[h].raw();
+			for (int i = 0; i < s; ++i) {
+				x[i] = modulo::mul_lazy(x[i], f);
+				x[i] -= (x[i] >= mod ? mod : 0);
+			}
+		}
 	}
 	void fourier_transform(std::vector<modulo> &v, bool inverse) {
-		int s = v.size();
-		for (int i = 0, j = 1; j < s - 1; ++j) {
-			for (int k = s >> 1; k >(i ^= k); k >>= 1);
-			if (i < j) std::swap(v[i], v[j]);
-		}
-		int sc = 0, sz = 1;
-		while (sz < s) sz *= 2, ++sc;
-		std::vector<modulo> pw(s + 1); pw[0] = 1;
-		for (int i = 1; i <= s; i++) pw[i] = pw[i - 1] * roots[sc];
-		int qs = s;
-		for (int b = 1; b < s; b <<= 1) {
-			qs >>= 1;
-			for (int i = 0; i < s; i += b * 2) {
-				for (int j = i; j < i + b; ++j) {
-					modulo delta = pw[(inverse ? b * 2 - j + i : j - i) * qs] * v[j + b];
-					v[j + b] = v[j] - delta;
-					v[j] += delta;
+		transform(v.data(), v.size(), inverse);
+	}
+	void convolve_batch(const modulo* v1, int n1, const modulo* v2, int n2, modulo* out, int count) {
+		// count products at once: v1 holds count polynomials of n1 coefficients one after another, v2 count of n2, and product i
+		// (n1 + n2 - 1 coefficients) is written at out + i * (n1 + n2 - 1). The two work buffers are shared by all of them
+		if (count <= 0 || n1 <= 0 || n2 <= 0) return;
+		int n = n1 + n2 - 1;
+		BIGINT_COUNT(instrument::op_convolve);
+		if (std::min(n1, n2) <= tuning().convolve_threshold) {
+			for (int c = 0; c < count; ++c) {
+				const modulo* x = v1 + size_t(c) * n1;
+				const modulo* y = v2 + size_t(c) * n2;
+				modulo* z = out + size_t(c) * n;
+				std::fill(z, z + n, modulo());
+				for (int i = 0; i < n1; ++i) {
+					for (int j = 0; j < n2; ++j) {
+						z[i + j] += x[i] * y[j];
+					}
 				}
 			}
+			return;
 		}
-		if (inverse) {
-			for (int i = 0; i < s; ++i) v[i] *= powinv[sc];
+		int s = 1;
+		while (s < n) s <<= 1;
+		std::vector<modulo> x(s), y(s);
+		BIGINT_ALLOC(2 * s * sizeof(modulo));
+		for (int c = 0; c < count; ++c) {
+			std::copy(v1 + size_t(c) * n1, v1 + size_t(c + 1) * n1, x.begin());
+			std::fill(x.begin() + n1, x.end(), modulo());
+			std::copy(v2 + size_t(c) * n2, v2 + size_t(c + 1) * n2, y.begin());
+			std::fill(y.begin() + n2, y.end(), modulo());
+			transform(x.data(), s, false);
+			transform(y.data(), s, false);
+			{
+				BIGINT_PHASE(instrument::phase_pointwise);
+				for (int i = 0; i < s; ++i) x[i] *= y[i];
+			}
+			transform(x.data(), s, true);
+			std::copy(x.begin(), x.begin() + n, out + size_t(c) * n);
 		}
 	}
-	std::vector<modulo> convolve(std::vector<modulo> v1, std::vector<modulo> v2) {
-		const int threshold = 16;
-		if (v1.size() < v2.size()) swap(v1, v2);
-		int s1 = 1; while (s1 < v1.size()) s1 <<= 1; v1.resize(s1);
-		int s2 = 1; while (s2 < v2.size()) s2 <<= 1; v2.resize(s2 * 2);
-		std::vector<modulo> ans(s1 + s2);
+	std::vector<modulo> convolve_batch(const std::vector<modulo>& v1, int n1, const std::vector<modulo>& v2, int n2) {
+		// The same on vectors: v1.size() / n1 (= v2.size() / n2) products, concatenated in the result
+		int count = (n1 > 0 ? v1.size() / n1 : 0);
+		std::vector<modulo> ans(size_t(count) * std::max(n1 + n2 - 1, 0));
+		convolve_batch(v1.data(), n1, v2.data(), n2, ans.data(), count);
+		return ans;
+	}
+	struct spectrum {
+		// Operand prepared for convolve_spectrum(): padded to a power of two s2, and transformed at size 2 * s2 unless it is small enough for the schoolbook method
+		int s2;
+		bool transformed;
+		std::vector<modulo> v;
+	};
+	spectrum get_spectrum(std::vector<modulo> v2) {
+		const int threshold = tuning().convolve_threshold;
+		int s2 = 1; while (s2 < v2.size()) s2 <<= 1;
 		if (s2 <= threshold) {
+			v2.resize(s2);
+			return spectrum{ s2, false, v2 };
+		}
+		v2.resize(s2 * 2);
+		fourier_transform(v2, false);
+		return spectrum{ s2, true, v2 };
+	}
+	std::vector<modulo> convolve_spectrum(std::vector<modulo> v1, const spectrum& sp) {
+		int s2 = sp.s2;
+		int s1 = s2; while (s1 < v1.size()) s1 <<= 1; v1.resize(s1);
+		std::vector<modulo> ans(s1 + s2);
+		BIGINT_COUNT(instrument::op_convolve);
+		BIGINT_ALLOC((s1 + s2) * sizeof(modulo));
+		if (!sp.transformed) {
 			for (int i = 0; i < s1; ++i) {
 				for (int j = 0; j < s2; ++j) {
-					ans[i + j] += v1[i] * v2[j];
+					ans[i + j] += v1[i] * sp.v[j];
 				}
 			}
 		}
 		else {
-			fourier_transform(v2, false);
 			for (int i = 0; i < s1; i += s2) {
 				std::vector<modulo> v(v1.begin() + i, v1.begin() + i + s2);
 				v.resize(s2 * 2);
 				fourier_transform(v, false);
-				for (int j = 0; j < v.size(); ++j) v[j] *= v2[j];
+				{
+					BIGINT_PHASE(instrument::phase_pointwise);
+					for (int j = 0; j < v.size(); ++j) v[j] *= sp.v[j];
+				}
 				fourier_transform(v, true);
 				for (int j = 0; j < s2 * 2; ++j) {
 					ans[i + j] += v[j];
@@ -81,6 +273,97 @@ public:
 		}
 		return ans;
 	}
+	std::vector<modulo> convolve(std::vector<modulo> v1, std::vector<modulo> v2) {
+		if (v1.size() < v2.size()) swap(v1, v2);
+		return convolve_spectrum(v1, get_spectrum(v2));
+	}
+	std::vector<modulo> square(std::vector<modulo> v) {
+		// Same as convolve(v, v), but with a single forward transform
+		const int threshold = tuning().convolve_threshold;
+		int s = 1; while (s < v.size()) s <<= 1;
+		std::vector<modulo> ans(s * 2);
+		if (s <= threshold) {
+			v.resize(s);
+			for (int i = 0; i < s; ++i) {
+				for (int j = 0; j < s; ++j) {
+					ans[i + j] += v[i] * v[j];
+				}
+			}
+			return ans;
+		}
+		v.resize(s * 2);
+		fourier_transform(v, false);
+		for (int i = 0; i < v.size(); ++i) v[i] *= v[i];
+		fourier_transform(v, true);
+		return v;
+	}
+	std::vector<modulo> cyclic_convolve(std::vector<modulo> v1, std::vector<modulo> v2, int s) {
+		// Convolution modulo x^s - 1 (s is a power of two, and both vectors must have at most s elements)
+		v1.resize(s); v2.resize(s);
+		fourier_transform(v1, false);
+		fourier_transform(v2, false);
+		for (int i = 0; i < s; ++i) v1[i] *= v2[i];
+		fourier_transform(v1, true);
+		return v1;
+	}
+	static double convolve_low_cost(int t) {
+		// Estimated work of convolve_low() with t coefficients, in butterflies. Returns the cost of a full product when splitting doesn't pay
+		if (t <= tuning().short_direct_threshold) return 0.5 * t * t;
+		int s = 1, lg = 0; while (s < t) s <<= 1, ++lg;
+		double full = 3.0 * (2 * s) * (lg + 1);
+		double split = 3.0 * s * lg + (s <= tuning().short_mulders_threshold ? 2 * convolve_low_cost(t - s / 2) : convolve_low_cost(2 * t - 1 - s));
+		return split * 1.1 < full ? split : full;
+	}
+	std::vector<modulo> convolve_low(std::vector<modulo> v1, std::vector<modulo> v2, int t) {
+		// Only the lowest t coefficients of convolve(v1, v2)
+		v1.resize(t); v2.resize(t);
+		std::vector<modulo> ans(t);
+		if (t <= tuning().short_direct_threshold) {
+			for (int i = 0; i < t; ++i) {
+				for (int j = 0; i + j < t; ++j) {
+					ans[i + j] += v1[i] * v2[j];
+				}
+			}
+			return ans;
+		}
+		int s = 1, lg = 0; while (s < t) s <<= 1, ++lg;
+		if (s > (1 << depth) || convolve_low_cost(t) >= 3.0 * (2 * s) * (lg + 1)) {
+			// The split part would be too large: a full product (transform size 2s) is cheaper
+			std::vector<modulo> full = convolve(v1, v2);
+			return std::vector<modulo>(full.begin(), full.begin() + t);
+		}
+		int k = s / 2, w = 2 * t - 1 - s;
+		if (s <= tuning().short_mulders_threshold) {
+			// Mulders' short product: full product of the lower k coefficients, plus two short products for the pairs above them
+			std::vector<modulo> lo = convolve(std::vector<modulo>(v1.begin(), v1.begin() + k), std::vector<modulo>(v2.begin(), v2.begin() + k));
+			std::vector<modulo> c1 = convolve_low(std::vector<modulo>(v1.begin() + k, v1.end()), v2, t - k);
+			std::vector<modulo> c2 = convolve_low(v1, std::vector<modulo>(v2.begin() + k, v2.end()), t - k);
+			for (int i = 0; i < t; ++i) {
+				ans[i] = lo[i];
+				if (i >= k) ans[i] += c1[i - k] + c2[i - k];
+			}
+			return ans;
+		}
+		// Convolution modulo x^s - 1 adds coefficient j + s onto coefficient j: the top w coefficients of the product are computed
+		// as a short product of the reversed vectors, and subtracted
+		std::vector<modulo> cyc = cyclic_convolve(v1, v2, s);
+		std::vector<modulo> hi = convolve_low(std::vector<modulo>(v1.rbegin(), v1.rbegin() + w), std::vector<modulo>(v2.rbegin(), v2.rbegin() + w), w);
+		for (int i = 0; i < t; ++i) {
+			ans[i] = cyc[i];
+			if (i < w) ans[i] -= hi[w - 1 - i];
+		}
+		return ans;
+	}
+	std::vector<modulo> convolve_high(std::vector<modulo> v1, std::vector<modulo> v2, int from) {
+		// Only the coefficients from x^from upwards of convolve(v1, v2), which are the lowest ones of the reversed convolution
+		int t = int(v1.size() + v2.size()) - 1 - from;
+		if (t <= 0) return std::vector<modulo>();
+		std::reverse(v1.begin(), v1.end());
+		std::reverse(v2.begin(), v2.end());
+		std::vector<modulo> ans = convolve_low(v1, v2, t);
+		std::reverse(ans.begin(), ans.end());
+		return ans;
+	}
 };
 
 #endif
\ No newline at end of file
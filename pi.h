@@ -0,0 +1,50 @@
+#ifndef ___CLASS_PI
+#define ___CLASS_PI
+
+#include "async.h"
+#include "serialize.h"
+
+inline bigfloat calculate_pi(int final_scale, checkpointer* cp = nullptr) {
+	// pi with final_scale digits (in D-ary) after the point, by the Gauss-Legendre algorithm.
+	// With a checkpointer, the state after an iteration is saved whenever cp->due(), and a run resumes from a saved state of the same final_scale
+	precision_guard guard(final_scale + 2);
+	bigfloat a(bigint(1) << final_scale, -final_scale);
+	bigfloat b = bigfloat(bigint(1) << (2 * final_scale), -2 * final_scale) / sqrt(bigint(2), final_scale);
+	bigfloat t = bigfloat(bigint(1) << final_scale, -final_scale).divide_by_2().divide_by_2();
+	bigfloat p(1);
+	bigfloat ans;
+	checkpoint state;
+	if (cp != nullptr && cp->resume(state) && state.ints["final_scale"] == bigint(final_scale)) {
+		a = state.floats["a"], b = state.floats["b"], t = state.floats["t"], p = state.floats["p"], ans = state.floats["ans"];
+	}
+	else state = checkpoint(), state.ints["final_scale"] = bigint(final_scale);
+	while (true) {
+		// eval, the square root and the update of t are independent of each other, so they run at the same time
+		task<bigfloat> eval_task = div_async((a + b) * (a + b), t * bigfloat(4));
+		task<bigfloat> xb = sqrt_async(a * b, final_scale);
+		bigfloat xa = (a + b).divide_by_2();
+		bigfloat xt = t - p * (a - xa) * (a - xa);
+		bigfloat xp = p * bigfloat(2);
+		bigfloat eval = eval_task.get();
+		eval.round(final_scale + 1, rounding::nearest); // the last digit of the working precision is a guard digit
+		if (eval == ans) {
+			xb.wait();
+			break;
+		}
+		ans = eval;
+		a = xa;
+		b = xb.get();
+		t = xt;
+		p = xp;
+		++state.step;
+		if (cp != nullptr && cp->due()) {
+			state.floats["a"] = a, state.floats["b"] = b, state.floats["t"] = t, state.floats["p"] = p, state.floats["ans"] = ans;
+			cp->save(state);
+			state.floats.clear();
+		}
+	}
+	if (cp != nullptr) cp->finish();
+	return ans;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef ___CLASS_POLYNOMIAL
+#define ___CLASS_POLYNOMIAL
+
+// Polynomials over modint types whose modulus is an NTT prime (p = c * 2^k + 1), such as modulo998 below.
+// A polynomial is a std::vector<modulo> of its coefficients, lowest first. The products use the in-place transforms of
+// ntt<modulo> on buffers of the final size, so each operand is copied once into its transform buffer and nowhere else.
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "ntt.h"
+
+using modulo998 = modint<998244353, 3>;
+
+template<typename modulo>
+modulo poly_inverse_of(modulo x) {
+	// 1 / x, for x != 0
+	return x.binpow(modulo::get_mod() - 2);
+}
+
+template<typename modulo>
+std::vector<modulo> poly_multiply(const std::vector<modulo>& f, const std::vector<modulo>& g) {
+	if (f.empty() || g.empty()) return std::vector<modulo>();
+	int n = f.size() + g.size() - 1;
+	if (std::min(f.size(), g.size()) <= size_t(tuning().convolve_threshold)) {
+		std::vector<modulo> ans(n);
+		for (int i = 0; i < f.size(); ++i) {
+			for (int j = 0; j < g.size(); ++j) {
+				ans[i + j] += f[i] * g[j];
+			}
+		}
+		return ans;
+	}
+	int s = 1;
+	while (s < n) s <<= 1;
+	ntt<modulo> engine;
+	std::vector<modulo> x(s), y(s);
+	std::copy(f.begin(), f.end(), x.begin());
+	std::copy(g.begin(), g.end(), y.begin());
+	engine.transform(x.data(), s, false);
+	engine.transform(y.data(), s, false);
+	for (int i = 0; i < s; ++i) x[i] *= y[i];
+	engine.transform(x.data(), s, true);
+	x.resize(n);
+	return x;
+}
+
+template<typename modulo>
+std::vector<modulo> poly_inverse(const std::vector<modulo>& f, int n) {
+	// g with f * g = 1 (mod x^n), by Newton's iteration g <- g - (f * g - 1) * g, doubling the precision m each step.
+	// f[0] must not be 0. Both products of a step are cyclic at size 2m: the wrapped-around part of f * g lands in the lowest
+	// m coefficients, which are known (1, 0, ..., 0) and cleared, and the same for the second product, so nothing is lost
+	ntt<modulo> engine;
+	std::vector<modulo> g(1, poly_inverse_of(f[0]));
+	g.reserve(n);
+	for (int m = 1; m < n; m *= 2) {
+		std::vector<modulo> a(2 * m), b(2 * m);
+		std::copy(f.begin(), f.begin() + std::min<size_t>(f.size(), 2 * m), a.begin());
+		std::copy(g.begin(), g.end(), b.begin());
+		engine.transform(a.data(), 2 * m, false);
+		engine.transform(b.data(), 2 * m, false);
+		for (int i = 0; i < 2 * m; ++i) a[i] *= b[i];
+		engine.transform(a.data(), 2 * m, true);
+		std::fill(a.begin(), a.begin() + m, modulo());
+		engine.transform(a.data(), 2 * m, false);
+		for (int i = 0; i < 2 * m; ++i) a[i] *= b[i];
+		engine.transform(a.data(), 2 * m, true);
+		for (int i = m; i < 2 * m; ++i) g.push_back(modulo() - a[i]);
+	}
+	g.resize(n);
+	return g;
+}
+
+template<typename modulo>
+std::pair<std::vector<modulo>, std::vector<modulo>> poly_divide(const std::vector<modulo>& a, const std::vector<modulo>& b) {
+	// Quotient and remainder of a / b, where the highest coefficient of b (b.back()) is not 0. The remainder has b.size() - 1
+	// coefficients (zeros included). The quotient is the product of the reversed polynomials, which is a power series
+	int n = a.size(), m = b.size();
+	if (n < m) {
+		std::vector<modulo> r(a);
+		r.resize(m - 1);
+		return std::make_pair(std::vector<modulo>(), r);
+	}
+	int k = n - m + 1;
+	std::vector<modulo> q;
+	if (m <= tuning().convolve_threshold) {
+		// Schoolbook division: no series inverse for a short divisor
+		std::vector<modulo> r(a);
+		modulo inv = poly_inverse_of(b.back());
+		q.resize(k);
+		for (int i = k - 1; i >= 0; --i) {
+			q[i] = r[i + m - 1] * inv;
+			for (int j = 0; j < m; ++j) r[i + j] -= q[i] * b[j];
+		}
+		r.resize(m - 1);
+		return std::make_pair(q, r);
+	}
+	std::vector<modulo> ra(a.rbegin(), a.rbegin() + k), rb(b.rbegin(), b.rbegin() + std::min(m, k));
+	q = poly_multiply(ra, poly_inverse(rb, k));
+	q.resize(k);
+	std::reverse(q.begin(), q.end());
+	std::vector<modulo> r = poly_multiply(b, q);
+	r.resize(m - 1);
+	for (int i = 0; i < m - 1; ++i) r[i] = a[i] - r[i];
+	return std::make_pair(q, r);
+}
+
+template<typename modulo>
+std::vector<modulo> poly_evaluate(const std::vector<modulo>& f, const std::vector<modulo>& x) {
+	// f(x[0]), f(x[1]), ...: f is reduced modulo the products of (X - x[i]) over a binary tree of the points (the subproduct
+	// tree), down to blocks of at most 32 points, which are evaluated by Horner's rule
+	const int block = 32;
+	int n = x.size();
+	std::vector<modulo> ans(n);
+	if (n == 0) return ans;
+	int leaves = 1;
+	while (leaves * block < n) leaves *= 2;
+	// tree[v]: the product over the points of node v (leaves are blocks of consecutive points), in heap order
+	std::vector<std::vector<modulo>> tree(2 * leaves);
+	for (int v = 0; v < leaves; ++v) {
+		std::vector<modulo>& p = tree[leaves + v];
+		p.assign(1, modulo(1));
+		for (int i = v * block; i < std::min(n, (v + 1) * block); ++i) {
+			// p *= (X - x[i])
+			p.push_back(modulo());
+			for (int j = p.size() - 1; j >= 1; --j) p[j] = p[j - 1] - p[j] * x[i];
+			p[0] = modulo() - p[0] * x[i];
+		}
+	}
+	for (int v = leaves - 1; v >= 1; --v) tree[v] = poly_multiply(tree[2 * v], tree[2 * v + 1]);
+	// rem[v]: f modulo tree[v], computed from the parent's remainder; tree[v] is released once its children are reduced
+	std::vector<std::vector<modulo>> rem(2 * leaves);
+	rem[1] = poly_divide(f, tree[1]).second;
+	for (int v = 1; v < leaves; ++v) {
+		rem[2 * v] = poly_divide(rem[v], tree[2 * v]).second;
+		rem[2 * v + 1] = poly_divide(rem[v], tree[2 * v + 1]).second;
+		std::vector<modulo>().swap(rem[v]);
+		std::vector<modulo>().swap(tree[v]);
+	}
+	for (int v = 0; v < leaves; ++v) {
+		const std::vector<modulo>& r = rem[leaves + v];
+		for (int i = v * block; i < std::min(n, (v + 1) * block); ++i) {
+			modulo y;
+			for (int j = int(r.size()) - 1; j >= 0; --j) y = y * x[i] + r[j];
+			ans[i] = y;
+		}
+	}
+	return ans;
+}
+
+#endif
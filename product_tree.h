@@ -0,0 +1,178 @@
+#ifndef ___CLASS_PRODUCTTREE
+#define ___CLASS_PRODUCTTREE
+
+#include "async.h"
+#include "serialize.h"
+#include <cstdint>
+
+// Balanced product trees and remainder trees.
+// Multiplying a long list left to right makes one operand grow while the other stays small,
+// so every step re-runs small transforms over the whole accumulator. Multiplying in a balanced
+// tree keeps both operands of every product about the same size instead.
+
+inline int tree_threads() { return scheduler().size(); }
+
+// Runs f(0), f(1), ..., f(n - 1) as up to "threads" tasks in the scheduler. The calls must be independent.
+template<typename Function>
+void tree_parallel_for(int n, int threads, const Function& f) {
+	threads = std::min(threads, n);
+	if (threads <= 1) {
+		for (int i = 0; i < n; ++i) f(i);
+		return;
+	}
+	std::vector<task<bool>> workers;
+	for (int t = 1; t < threads; ++t) {
+		workers.push_back(task<bool>([&f, n, threads, t]() {
+			for (int i = t; i < n; i += threads) f(i);
+			return true;
+		}));
+	}
+	for (int i = 0; i < n; i += threads) f(i);
+	for (task<bool>& w : workers) w.wait();
+}
+
+template<typename Iterator>
+bigint product(Iterator first, Iterator last, int threads) {
+	int n = std::distance(first, last);
+	if (n == 0) return bigint(1);
+	if (n == 1) return bigint(*first);
+	Iterator mid = first; std::advance(mid, n / 2);
+	if (threads >= 2) {
+		int limbs = 0;
+		for (Iterator it = first; it != last && limbs < tuning().tree_parallel_limbs; ++it) limbs += bigint(*it).size();
+		if (limbs >= tuning().tree_parallel_limbs) {
+			task<bigint> left([=]() { return product(first, mid, threads / 2); });
+			bigint right = product(mid, last, threads - threads / 2);
+			return left.get() * right;
+		}
+	}
+	return product(first, mid, 1) * product(mid, last, 1);
+}
+template<typename Iterator>
+bigint product(Iterator first, Iterator last) { return product(first, last, tree_threads()); }
+inline bigint product(const std::vector<bigint>& v) { return product(v.begin(), v.end()); }
+
+// Binary splitting that survives a restart: v is split into "chunks" ranges, whose products are kept in the checkpoint
+// (saved whenever cp.due() and after the last range), and ranges already in a checkpoint of the same v are not recomputed.
+inline bigint product(const std::vector<bigint>& v, checkpointer& cp, int chunks = 64) {
+	chunks = std::max(1, std::min<int>(chunks, v.size()));
+	// A checkpoint is resumed only if it was taken for the same terms: their checksums are combined into a fingerprint
+	uint64_t h = 14695981039346656037ull;
+	for (const bigint& x : v) h = (h ^ serial_checksum(x)) * 1099511628211ull;
+	bigint fingerprint(std::to_string(h));
+	checkpoint state;
+	if (!cp.resume(state) || state.ints["terms"] != bigint((long long)v.size()) || state.ints["chunks"] != bigint(chunks) || state.ints["fingerprint"] != fingerprint) {
+		state = checkpoint();
+		state.ints["terms"] = bigint((long long)v.size()), state.ints["chunks"] = bigint(chunks), state.ints["fingerprint"] = fingerprint;
+	}
+	for (int i = 0; i < chunks; ++i) {
+		std::string name = "chunk" + std::to_string(i);
+		if (state.ints.count(name)) continue;
+		state.ints[name] = product(v.begin() + (long long)v.size() * i / chunks, v.begin() + (long long)v.size() * (i + 1) / chunks);
+		++state.step;
+		if (cp.due() || i == chunks - 1) cp.save(state);
+	}
+	std::vector<bigint> parts;
+	for (int i = 0; i < chunks; ++i) parts.push_back(std::move(state.ints["chunk" + std::to_string(i)]));
+	bigint ans = product(parts);
+	cp.finish();
+	return ans;
+}
+
+// Product of many small factors: factors are packed into 64-bit words first, so the tree only sees full leaves
+inline bigint product_small(const std::vector<uint32_t>& v) {
+	std::vector<bigint> leaves;
+	unsigned long long cur = 1;
+	for (uint32_t x : v) {
+		if (x == 0) return bigint(0);
+		if (cur > (1ull << 62) / x) leaves.push_back(bigint((long long)cur)), cur = 1;
+		cur *= x;
+	}
+	if (cur != 1 || leaves.empty()) leaves.push_back(bigint((long long)cur));
+	return product(leaves);
+}
+
+inline std::vector<uint32_t> tree_primes(int n) {
+	std::vector<bool> sieve(n + 1, true);
+	std::vector<uint32_t> primes;
+	for (int i = 2; i <= n; ++i) {
+		if (!sieve[i]) continue;
+		primes.push_back(i);
+		for (long long j = 1ll * i * i; j <= n; j += i) sieve[j] = false;
+	}
+	return primes;
+}
+
+// swing(n) = n! / (n/2)!^2, whose prime factorization is known directly
+inline bigint prime_swing(int n, const std::vector<uint32_t>& primes) {
+	std::vector<uint32_t> factors;
+	for (uint32_t p : primes) {
+		if (p > uint32_t(n)) break;
+		uint32_t power = 1;
+		for (int q = n / p; q > 0; q /= p) {
+			if (q % 2 == 1) power *= p;
+		}
+		if (power > 1) factors.push_back(power);
+	}
+	return product_small(factors);
+}
+inline bigint factorial_swing(int n, const std::vector<uint32_t>& primes) {
+	if (n < 2) return bigint(1);
+	bigint half = factorial_swing(n / 2, primes);
+	return half.square() * prime_swing(n, primes);
+}
+inline bigint factorial(int n) { return factorial_swing(n, tree_primes(n)); }
+
+inline bigint binomial(int n, int k) {
+	if (k < 0 || k > n) return bigint(0);
+	std::vector<uint32_t> factors;
+	for (uint32_t p : tree_primes(n)) {
+		// Legendre's formula: exponent of p is the number of carries when adding k and n - k in base p
+		int e = 0;
+		for (long long q = p; q <= n; q *= p) e += n / q - k / q - (n - k) / q;
+		for (int i = 0; i < e; ++i) factors.push_back(p);
+	}
+	return product_small(factors);
+}
+
+// Product tree over the moduli: level 0 is the moduli themselves, the last level is their product
+inline std::vector<std::vector<bigint>> product_levels(const std::vector<uint32_t>& m, int threads) {
+	std::vector<std::vector<bigint>> levels(1);
+	for (uint32_t x : m) levels[0].push_back(bigint((long long)x));
+	while (levels.back().size() > 1) {
+		const std::vector<bigint>& cur = levels.back();
+		std::vector<bigint> next((cur.size() + 1) / 2);
+		tree_parallel_for(next.size(), cur[0].size() >= tuning().tree_parallel_limbs / 16 ? threads : 1, [&](int i) {
+			next[i] = (2 * i + 1 < cur.size() ? cur[2 * i] * cur[2 * i + 1] : cur[2 * i]);
+		});
+		levels.push_back(next);
+	}
+	return levels;
+}
+
+inline uint32_t mod_small(const bigint& x, uint32_t m) {
+	unsigned long long r = 0;
+	for (int i = x.size() - 1; i >= 0; --i) r = (r * digit_base + x.nth_digit(i)) % m;
+	return r;
+}
+
+// Remainder tree: x mod m[i] for every i, reducing x down the product tree of the moduli
+inline std::vector<uint32_t> multi_mod(const bigint& x, const std::vector<uint32_t>& m, int threads) {
+	if (m.empty()) return {};
+	std::vector<std::vector<bigint>> levels = product_levels(m, threads);
+	std::vector<bigint> rem = { x % levels.back()[0] };
+	for (int d = int(levels.size()) - 2; d >= 1; --d) {
+		const std::vector<bigint>& cur = levels[d];
+		std::vector<bigint> next(cur.size());
+		tree_parallel_for(next.size(), cur[0].size() >= tuning().tree_parallel_limbs / 16 ? threads : 1, [&](int i) {
+			next[i] = rem[i / 2] % cur[i];
+		});
+		rem.swap(next);
+	}
+	std::vector<uint32_t> ans(m.size());
+	for (int i = 0; i < m.size(); ++i) ans[i] = mod_small(rem[i / 2], m[i]);
+	return ans;
+}
+inline std::vector<uint32_t> multi_mod(const bigint& x, const std::vector<uint32_t>& m) { return multi_mod(x, m, tree_threads()); }
+
+#endif
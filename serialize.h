@@ -0,0 +1,290 @@
+#ifndef ___CLASS_SERIALIZE
+#define ___CLASS_SERIALIZE
+
+// Binary format of bigint / bigfloat, version 1 (every record a multiple of 8 bytes):
+//   header (40 bytes): "BIGN", uint16 version, uint16 kind (0 = bigint, 1 = bigfloat), uint32 limb base, int32 precision (limbs, 0 = exact),
+//                      int64 scale, uint64 number of limbs, uint64 checksum (FNV-1a over the limbs)
+//   limbs: uint16 each, lowest first, zero-padded to a multiple of 8 bytes
+// Numbers are in the byte order of the host that wrote the file (little-endian on x86 and ARM). A file from a host of the other
+// byte order is rejected, as its version field doesn't read as 1.
+// Two bytes per 4 decimal digits: half the size of the decimal text, and no conversion on either side.
+// A serial_view reads a record in place, e.g. from a mapped_file, so large values can be inspected without copying them.
+
+#include "newbigfloat.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BIGINT_HAS_MMAP
+#endif
+
+const uint16_t serial_version = 1;
+enum class serial_kind : uint16_t { integer = 0, floating = 1 };
+
+struct serial_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t kind;
+	uint32_t base;
+	int32_t precision;
+	int64_t scale;
+	uint64_t limbs;
+	uint64_t checksum;
+};
+static_assert(sizeof(serial_header) == 40, "serial_header must have no padding");
+
+inline uint64_t serial_padded(uint64_t bytes) { return (bytes + 7) / 8 * 8; }
+inline uint64_t serial_checksum(const bigint& x) {
+	uint64_t h = 14695981039346656037ull;
+	for (int i = 0; i < x.size(); ++i) h = (h ^ uint64_t(x.nth_digit(i))) * 1099511628211ull;
+	return h;
+}
+
+inline void write_record(std::ostream& os, const bigint& x, serial_kind kind, int64_t scale, int32_t precision) {
+	serial_header h;
+	std::memcpy(h.magic, "BIGN", 4);
+	h.version = serial_version;
+	h.kind = uint16_t(kind);
+	h.base = digit_base;
+	h.precision = precision;
+	h.scale = scale;
+	h.limbs = x.size();
+	h.checksum = serial_checksum(x);
+	os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	// Limbs are written in blocks, so no copy of the whole number is made
+	std::vector<uint16_t> block;
+	for (int i = 0; i < x.size(); i += 65536) {
+		int n = std::min(x.size() - i, 65536);
+		block.resize(n);
+		for (int j = 0; j < n; ++j) block[j] = x.nth_digit(i + j);
+		os.write(reinterpret_cast<const char*>(block.data()), 2 * n);
+	}
+	static const char zeros[8] = {};
+	os.write(zeros, serial_padded(2 * h.limbs) - 2 * h.limbs);
+}
+inline void write_binary(std::ostream& os, const bigint& x) { write_record(os, x, serial_kind::integer, 0, 0); }
+inline void write_binary(std::ostream& os, const bigfloat& x, int precision = bigfloat_precision().limbs) {
+	write_record(os, x.get_number(), serial_kind::floating, x.get_scale(), precision);
+}
+
+class serial_view {
+	// One record inside a buffer. Nothing is copied until to_bigint() / to_bigfloat()
+private:
+	serial_header h;
+	const unsigned char* p;
+public:
+	serial_view() : h(), p(nullptr) {};
+	bool parse(const void* data, size_t size) {
+		// Checks the header and the size; the limbs are checked by verify() and on conversion
+		p = nullptr;
+		if (size < sizeof(h)) return false;
+		std::memcpy(&h, data, sizeof(h));
+		if (std::memcmp(h.magic, "BIGN", 4) != 0 || h.version != serial_version || h.base != digit_base) return false;
+		if (h.kind > uint16_t(serial_kind::floating) || h.limbs == 0 || h.limbs > (size - sizeof(h)) / 2) return false;
+		if (serial_padded(2 * h.limbs) > size - sizeof(h)) return false;
+		p = static_cast<const unsigned char*>(data) + sizeof(h);
+		return true;
+	}
+	const serial_header& header() const { return h; }
+	serial_kind kind() const { return serial_kind(h.kind); }
+	int precision() const { return h.precision; }
+	int64_t scale() const { return h.scale; }
+	uint64_t size() const { return h.limbs; }
+	uint64_t bytes() const { return sizeof(h) + serial_padded(2 * h.limbs); } // size of the whole record
+	uint16_t limb(uint64_t i) const {
+		uint16_t x;
+		std::memcpy(&x, p + 2 * i, 2);
+		return x;
+	}
+	bool verify() const {
+		uint64_t c = 14695981039346656037ull;
+		for (uint64_t i = 0; i < h.limbs; ++i) c = (c ^ limb(i)) * 1099511628211ull;
+		return c == h.checksum;
+	}
+	bool to_bigint(bigint& x) const {
+		if (kind() != serial_kind::integer) return false;
+		std::vector<int> a(h.limbs);
+		for (uint64_t i = 0; i < h.limbs; ++i) {
+			a[i] = limb(i);
+			if (a[i] >= digit_base) return false;
+		}
+		if (a.size() > 1 && a.back() == 0) return false;
+		x = bigint(basic_integer<digit_base>(a));
+		return true;
+	}
+	bool to_bigfloat(bigfloat& x) const {
+		if (h.scale < std::numeric_limits<int>::min() || h.scale > std::numeric_limits<int>::max()) return false;
+		serial_view v = *this;
+		v.h.kind = uint16_t(serial_kind::integer);
+		bigint b;
+		if (!v.to_bigint(b)) return false;
+		x = bigfloat(b, int(h.scale));
+		return true;
+	}
+};
+
+class mapped_file {
+	// A read-only file in memory: mapped where mmap is available, read into a buffer elsewhere
+private:
+	const char* p;
+	size_t n;
+	std::vector<char> buffer;
+public:
+	mapped_file() : p(nullptr), n(0) {};
+	explicit mapped_file(const std::string& file) : p(nullptr), n(0) { open(file); }
+	~mapped_file() { close(); }
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	bool open(const std::string& file) {
+		close();
+#ifdef BIGINT_HAS_MMAP
+		int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m != MAP_FAILED) p = static_cast<const char*>(m), n = st.st_size;
+		}
+		::close(fd);
+		return p != nullptr;
+#else
+		std::ifstream is(file, std::ios::binary);
+		if (!is) return false;
+		buffer.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+		p = buffer.data(), n = buffer.size();
+		return n > 0;
+#endif
+	}
+	void close() {
+#ifdef BIGINT_HAS_MMAP
+		if (p != nullptr) munmap(const_cast<char*>(p), n);
+#endif
+		buffer.clear();
+		p = nullptr, n = 0;
+	}
+	bool is_open() const { return p != nullptr; }
+	const char* data() const { return p; }
+	size_t size() const { return n; }
+};
+
+inline bool save_binary(const std::string& file, const bigint& x) {
+	std::ofstream os(file, std::ios::binary);
+	write_binary(os, x);
+	return bool(os);
+}
+inline bool save_binary(const std::string& file, const bigfloat& x, int precision = bigfloat_precision().limbs) {
+	std::ofstream os(file, std::ios::binary);
+	write_binary(os, x, precision);
+	return bool(os);
+}
+inline bool load_binary(const std::string& file, bigint& x) {
+	mapped_file m(file);
+	serial_view v;
+	return v.parse(m.data(), m.size()) && v.verify() && v.to_bigint(x);
+}
+inline bool load_binary(const std::string& file, bigfloat& x) {
+	mapped_file m(file);
+	serial_view v;
+	return v.parse(m.data(), m.size()) && v.verify() && v.to_bigfloat(x);
+}
+
+// Checkpoints: the named state of an iterative computation, saved so that it can resume after a crash.
+// File: "BGCK", uint32 version, uint64 step, uint64 number of entries, then per entry uint64 name length, the name
+// zero-padded to a multiple of 8 bytes, and one record. The file is written to a temporary name and renamed over
+// the old one, so a crash while saving leaves the previous checkpoint intact.
+struct checkpoint {
+	uint64_t step = 0;
+	std::map<std::string, bigint> ints;
+	std::map<std::string, bigfloat> floats;
+
+	bool save(const std::string& file) const {
+		std::string tmp = file + ".tmp";
+		{
+			std::ofstream os(tmp, std::ios::binary);
+			uint32_t version = serial_version;
+			uint64_t entries = ints.size() + floats.size();
+			os.write("BGCK", 4);
+			os.write(reinterpret_cast<const char*>(&version), 4);
+			os.write(reinterpret_cast<const char*>(&step), 8);
+			os.write(reinterpret_cast<const char*>(&entries), 8);
+			for (const auto& e : ints) write_name(os, e.first), write_binary(os, e.second);
+			for (const auto& e : floats) write_name(os, e.first), write_binary(os, e.second);
+			os.flush();
+			if (!os) return false;
+		}
+#ifdef BIGINT_HAS_MMAP
+		int fd = ::open(tmp.c_str(), O_RDONLY);
+		if (fd >= 0) fsync(fd), ::close(fd);
+#endif
+		return std::rename(tmp.c_str(), file.c_str()) == 0;
+	}
+	bool load(const std::string& file) {
+		// Leaves *this unchanged unless the whole file is valid
+		mapped_file m(file);
+		if (m.size() < 24 || std::memcmp(m.data(), "BGCK", 4) != 0) return false;
+		uint32_t version;
+		uint64_t s, entries, pos = 24;
+		std::memcpy(&version, m.data() + 4, 4);
+		std::memcpy(&s, m.data() + 8, 8);
+		std::memcpy(&entries, m.data() + 16, 8);
+		if (version != serial_version) return false;
+		checkpoint c;
+		c.step = s;
+		for (uint64_t i = 0; i < entries; ++i) {
+			uint64_t len;
+			if (m.size() - pos < 8) return false;
+			std::memcpy(&len, m.data() + pos, 8);
+			pos += 8;
+			if (len > m.size() - pos || m.size() - pos < serial_padded(len)) return false;
+			std::string name(m.data() + pos, len);
+			pos += serial_padded(len);
+			serial_view v;
+			if (!v.parse(m.data() + pos, m.size() - pos) || !v.verify()) return false;
+			bool ok = (v.kind() == serial_kind::integer ? v.to_bigint(c.ints[name]) : v.to_bigfloat(c.floats[name]));
+			if (!ok) return false;
+			pos += v.bytes();
+		}
+		*this = c;
+		return true;
+	}
+private:
+	static void write_name(std::ostream& os, const std::string& name) {
+		uint64_t len = name.size();
+		static const char zeros[8] = {};
+		os.write(reinterpret_cast<const char*>(&len), 8);
+		os.write(name.data(), len);
+		os.write(zeros, serial_padded(len) - len);
+	}
+};
+
+class checkpointer {
+	// Hook for long computations: resume() restores the last checkpoint, due() tells when the next one should be taken.
+	//   checkpointer cp("pi.ckpt", 600); // a checkpoint at most every 10 minutes
+	//   bigfloat x = calculate_pi(250000000, &cp);
+private:
+	std::string file;
+	double interval;
+	std::chrono::steady_clock::time_point last;
+public:
+	checkpointer(const std::string& file_, double interval_seconds = 600) : file(file_), interval(interval_seconds), last(std::chrono::steady_clock::now()) {};
+	const std::string& path() const { return file; }
+	bool resume(checkpoint& c) const { return c.load(file); }
+	bool due() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - last).count() >= interval; }
+	bool save(const checkpoint& c) {
+		last = std::chrono::steady_clock::now();
+		return c.save(file);
+	}
+	void finish() { std::remove(file.c_str()); } // the computation is complete, so its checkpoint is no longer needed
+};
+
+#endif
@@ -0,0 +1,176 @@
+// Measures the crossover points of the multiplication and division algorithms on this machine, and writes them to a tuning file
+// which the library reads at startup (see tuning.h).
+// Build: g++ -std=c++17 -O2 -pthread tune.cpp -o tune
+// Usage: tune [FILE] (default: bigint_tuning.cfg)
+#include "newbigfloat.h"
+#include <chrono>
+#include <functional>
+#include <random>
+using namespace std;
+
+mt19937_64 rng(20161);
+bigint random_bigint(int limbs) {
+	vector<int> v(limbs);
+	for (int& x : v) x = rng() % digit_base;
+	v.back() = 1 + rng() % (digit_base - 1);
+	return bigint(basic_integer<digit_base>(v));
+}
+vector<modulo1> random_modvector(int n) {
+	vector<modulo1> v(n);
+	for (modulo1& x : v) x = rng() % digit_base;
+	return v;
+}
+
+double measure(const function<void()>& f) {
+	// Seconds per call: the best of 5 rounds, each repeating f for at least 10 milliseconds
+	double best = 1e100;
+	for (int round = 0; round < 5; ++round) {
+		int reps = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		double elapsed = 0;
+		while (elapsed < 0.01) {
+			f();
+			++reps;
+			elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+		best = min(best, elapsed / reps);
+	}
+	return best;
+}
+
+int tune_convolve_threshold() {
+	// The largest power of two s such that multiplying by an s-limb operand is faster by the schoolbook method than by NTT
+	int ans = 1;
+	for (int s = 2; s <= 512; s *= 2) {
+		bigint x = random_bigint(max(2048, 4 * s)), y = random_bigint(s);
+		tuning().convolve_threshold = s;
+		double schoolbook = measure([&]() { bigint z = x * y; });
+		tuning().convolve_threshold = s / 2;
+		double transform = measure([&]() { bigint z = x * y; });
+		cerr << "  convolve " << s << " limbs: schoolbook " << schoolbook << "s, NTT " << transform << "s" << endl;
+		if (schoolbook > transform) break;
+		ans = s;
+	}
+	return ans;
+}
+
+int tune_short_direct_threshold() {
+	// The largest t such that the lowest t coefficients of a product are faster to compute directly than by the split methods
+	int ans = 1;
+	for (int t = 4; t <= 512; t *= 2) {
+		vector<modulo1> v1 = random_modvector(t), v2 = random_modvector(t);
+		tuning().short_direct_threshold = t;
+		double direct = measure([&]() { ntt_base1.convolve_low(v1, v2, t); });
+		tuning().short_direct_threshold = t - 1;
+		double split = measure([&]() { ntt_base1.convolve_low(v1, v2, t); });
+		cerr << "  short product " << t << " coefficients: direct " << direct << "s, split " << split << "s" << endl;
+		if (direct > split) break;
+		ans = t;
+	}
+	return ans;
+}
+
+int tune_short_mulders_threshold() {
+	// The largest transform size s at which Mulders' split beats the cyclic transform, measured at t = 9s/16 where both apply
+	int ans = tuning().short_direct_threshold, s = 2;
+	while (s / 2 + s / 16 <= ans) s *= 2;
+	for (; s <= 65536; s *= 2) {
+		int t = s / 2 + s / 16;
+		vector<modulo1> v1 = random_modvector(t), v2 = random_modvector(t);
+		tuning().short_mulders_threshold = s;
+		double mulders = measure([&]() { ntt_base1.convolve_low(v1, v2, t); });
+		tuning().short_mulders_threshold = s / 2;
+		double cyclic = measure([&]() { ntt_base1.convolve_low(v1, v2, t); });
+		cerr << "  short product " << t << " coefficients: Mulders " << mulders << "s, cyclic " << cyclic << "s" << endl;
+		if (mulders > cyclic) break;
+		ans = s;
+	}
+	return ans;
+}
+
+pair<int, int> tune_fft() {
+	// fft_min_limbs: the smallest balanced size from which the FFT beats the NTT at it and at twice it.
+	// fft_max_limbs: the total size of the last balanced product (up to 2^18 limbs per operand) before the FFT loses twice in a row
+	tuning_table saved = tuning();
+	auto compare = [&](int limbs, double& fft, double& ntt) {
+		bigint x = random_bigint(limbs), y = random_bigint(limbs);
+		tuning().fft_min_limbs = 1, tuning().fft_max_limbs = 1 << 30;
+		fft = measure([&]() { bigint z = x * y; });
+		tuning().fft_min_limbs = 1 << 30;
+		ntt = measure([&]() { bigint z = x * y; });
+		cerr << "  multiply " << limbs << " limbs: FFT " << fft << "s, NTT " << ntt << "s" << endl;
+	};
+	int lo = 1 << 30, hi = saved.fft_max_limbs, lost_at = 0;
+	bool won = false;
+	for (int limbs = 8; limbs <= (1 << 18); limbs *= 2) {
+		double fft, ntt;
+		compare(limbs, fft, ntt);
+		if (fft < ntt && !won) {
+			// Confirmed at twice the size, so one noisy measurement doesn't decide it
+			double fft2, ntt2;
+			compare(limbs * 2, fft2, ntt2);
+			if (fft2 < ntt2) lo = limbs, won = true;
+		}
+		else if (fft >= ntt && won) {
+			if (lost_at != 0) {
+				hi = lost_at;
+				break;
+			}
+			lost_at = limbs;
+		}
+		else lost_at = 0;
+		if (!won && limbs >= 4096) break;
+	}
+	tuning() = saved;
+	return make_pair(lo, hi);
+}
+
+pair<int, int> tune_div_seed() {
+	// Seed precisions of the Newton iteration in division, by the total time over several sizes
+	vector<pair<int, int>> candidates = { { 1, 2 }, { 2, 4 }, { 3, 6 }, { 4, 8 }, { 6, 12 }, { 8, 16 }, { 12, 24 } };
+	vector<pair<bigint, bigint>> inputs;
+	for (int n : { 16, 256, 4096 }) inputs.push_back(make_pair(random_bigint(2 * n), random_bigint(n)));
+	pair<int, int> ans = { tuning().div_seed_quotient, tuning().div_seed_divisor };
+	double best = 1e100;
+	for (pair<int, int> c : candidates) {
+		tuning().div_seed_quotient = c.first;
+		tuning().div_seed_divisor = c.second;
+		bool correct = true;
+		for (const pair<bigint, bigint>& in : inputs) {
+			bigint q = in.first / in.second;
+			correct = correct && q * in.second <= in.first && in.first < (q + bigint(1)) * in.second;
+		}
+		if (!correct) continue;
+		double time = measure([&]() { for (const pair<bigint, bigint>& in : inputs) bigint q = in.first / in.second; });
+		cerr << "  division seed " << c.first << "/" << c.second << ": " << time << "s" << endl;
+		if (time < best) best = time, ans = c;
+	}
+	return ans;
+}
+
+int main(int argc, char** argv) {
+	string file = (argc >= 2 ? argv[1] : "bigint_tuning.cfg");
+	tuning_table table = tuning();
+	table.convolve_threshold = tuning().convolve_threshold = tune_convolve_threshold();
+	table.short_direct_threshold = tuning().short_direct_threshold = tune_short_direct_threshold();
+	table.short_mulders_threshold = tuning().short_mulders_threshold = tune_short_mulders_threshold();
+	pair<int, int> fft = tune_fft();
+	table.fft_min_limbs = tuning().fft_min_limbs = fft.first;
+	table.fft_max_limbs = tuning().fft_max_limbs = fft.second;
+	pair<int, int> seed = tune_div_seed();
+	table.div_seed_quotient = tuning().div_seed_quotient = seed.first;
+	table.div_seed_divisor = tuning().div_seed_divisor = seed.second;
+	if (!table.save(file)) {
+		cerr << "cannot write " << file << endl;
+		return 1;
+	}
+	cout << "convolve_threshold " << table.convolve_threshold << "\n";
+	cout << "short_direct_threshold " << table.short_direct_threshold << "\n";
+	cout << "short_mulders_threshold " << table.short_mulders_threshold << "\n";
+	cout << "fft_min_limbs " << table.fft_min_limbs << "\n";
+	cout << "fft_max_limbs " << table.fft_max_limbs << "\n";
+	cout << "div_seed_quotient " << table.div_seed_quotient << "\n";
+	cout << "div_seed_divisor " << table.div_seed_divisor << "\n";
+	cout << "written to " << file << endl;
+	return 0;
+}
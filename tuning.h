@@ -0,0 +1,89 @@
+#ifndef ___CLASS_TUNING
+#define ___CLASS_TUNING
+
+// Crossover points between algorithms. The built-in values are used unless a config file written by tune.cpp is found:
+// the file named by the BIGINT_TUNING_FILE environment variable, or else "bigint_tuning.cfg" in the working directory.
+// The file is read once, at the first multiplication.
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+struct tuning_table {
+	int convolve_threshold = 16; // products whose smaller operand has at most this many limbs (rounded up to a power of two) use the schoolbook method
+	int short_direct_threshold = 32; // short products of at most this many coefficients are computed directly
+	int short_mulders_threshold = 1024; // short products up to this transform size split by Mulders' method, above it by a cyclic transform
+	int fft_min_limbs = 64; // products with both operands of at least this many limbs, at most fft_max_limbs in total, and
+	int fft_max_limbs = 1 << 11; // the larger operand at most fft_max_ratio times the smaller, use the floating-point FFT
+	int fft_max_ratio = 2;
+	int div_seed_quotient = 3; // limbs of the quotient and of the divisor in the first Newton steps of division
+	int div_seed_divisor = 6;
+	int tree_parallel_limbs = 4096; // product trees don't spawn tasks for subtrees smaller than this
+	int memory_budget_mb = 0; // if not 0, products follow plan_multiply() with this budget (in MiB) instead of always using the standard method
+
+	bool set(const std::string& key, int value) {
+		// A value out of range (e.g. from a hand-edited file) is rejected, and the key falls back to its built-in value:
+		// thresholds, fft_max_ratio and the seeds are at least 1, div_seed_divisor at least 2, memory_budget_mb at least 0
+		int tuning_table::* field;
+		int minimum = 1;
+		if (key == "convolve_threshold") field = &tuning_table::convolve_threshold;
+		else if (key == "short_direct_threshold") field = &tuning_table::short_direct_threshold;
+		else if (key == "short_mulders_threshold") field = &tuning_table::short_mulders_threshold;
+		else if (key == "fft_min_limbs") field = &tuning_table::fft_min_limbs;
+		else if (key == "fft_max_limbs") field = &tuning_table::fft_max_limbs;
+		else if (key == "fft_max_ratio") field = &tuning_table::fft_max_ratio;
+		else if (key == "div_seed_quotient") field = &tuning_table::div_seed_quotient;
+		else if (key == "div_seed_divisor") field = &tuning_table::div_seed_divisor, minimum = 2;
+		else if (key == "tree_parallel_limbs") field = &tuning_table::tree_parallel_limbs;
+		else if (key == "memory_budget_mb") field = &tuning_table::memory_budget_mb, minimum = 0;
+		else return false;
+		(*this).*field = (value >= minimum ? value : tuning_table().*field);
+		return value >= minimum;
+	}
+	bool load(const std::string& file) {
+		// Lines are "key value"; unknown keys and lines starting with '#' are ignored, and invalid values are replaced as in set()
+		std::ifstream is(file);
+		if (!is) return false;
+		std::string key;
+		int value;
+		while (is >> key) {
+			if (key[0] == '#') { std::getline(is, key); continue; }
+			if (is >> value) set(key, value);
+		}
+		if (div_seed_divisor < div_seed_quotient) {
+			// The Newton iteration of division can cycle forever with a divisor seed shorter than the quotient seed
+			div_seed_quotient = tuning_table().div_seed_quotient;
+			div_seed_divisor = tuning_table().div_seed_divisor;
+		}
+		return true;
+	}
+	bool save(const std::string& file) const {
+		std::ofstream os(file);
+		os << "# bigint-library tuning table (written by tune.cpp)\n";
+		os << "convolve_threshold " << convolve_threshold << "\n";
+		os << "short_direct_threshold " << short_direct_threshold << "\n";
+		os << "short_mulders_threshold " << short_mulders_threshold << "\n";
+		os << "fft_min_limbs " << fft_min_limbs << "\n";
+		os << "fft_max_limbs " << fft_max_limbs << "\n";
+		os << "fft_max_ratio " << fft_max_ratio << "\n";
+		os << "div_seed_quotient " << div_seed_quotient << "\n";
+		os << "div_seed_divisor " << div_seed_divisor << "\n";
+		os << "tree_parallel_limbs " << tree_parallel_limbs << "\n";
+		os << "memory_budget_mb " << memory_budget_mb << "\n";
+		return bool(os);
+	}
+};
+
+inline tuning_table load_tuning() {
+	tuning_table t;
+	const char* env = std::getenv("BIGINT_TUNING_FILE");
+	t.load(env != nullptr ? env : "bigint_tuning.cfg");
+	return t;
+}
+inline tuning_table& tuning() {
+	// Not synchronized: change it only while no other thread computes (tune.cpp does, between its measurements)
+	static tuning_table table = load_tuning();
+	return table;
+}
+
+#endif